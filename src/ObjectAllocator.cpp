@@ -1,11 +1,326 @@
 #include "ObjectAllocator.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <exception>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #include <immintrin.h>
+  #define OA_HAS_X86_SIMD 1
+#else
+  #define OA_HAS_X86_SIMD 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #define OA_HAS_MMAP 1
+#else
+  #define OA_HAS_MMAP 0
+#endif
+
+#if defined(__has_include)
+  #if __has_include(<execinfo.h>)
+    #include <execinfo.h>
+    #define OA_HAS_BACKTRACE 1
+  #endif
+#endif
+
+#ifndef OA_HAS_BACKTRACE
+  #define OA_HAS_BACKTRACE 0
+#endif
+
+// The call site the profile attributes an allocation to
+#if defined(__GNUC__) || defined(__clang__)
+  #define OA_CALLER() __builtin_return_address(0)
+  #define OA_COLD __attribute__((noinline, cold))
+#else
+  #define OA_CALLER() nullptr
+  #define OA_COLD
+#endif
+
+namespace {
+  /**
+   * @brief Size of a (2MB) huge page, MAP_HUGETLB mappings must be a multiple of it
+   */
+  constexpr usize HUGE_PAGE_SIZE = usize{2} << 20;
+
+  /**
+   * @brief Milliseconds on a monotonic clock, never 0 so 0 can mean "not stamped"
+   */
+  u64 idle_clock_ms() {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<u64>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) + 1;
+  }
+
+  /**
+   * @brief Where a profile site starts probing the index, from the label pointer and the call site
+   */
+  usize profile_hash(const char* const label, const void* const caller) {
+    const u64 hash = (reinterpret_cast<uptr>(label) ^ (reinterpret_cast<uptr>(caller) << 1)) * 0x9E3779B97F4A7C15UL;
+    return static_cast<usize>(hash >> 32);
+  }
+
+  /**
+   * @brief Where an interned label starts probing, from its contents (FNV-1a)
+   */
+  usize label_hash(const char* label) {
+    u64 hash = 0xCBF29CE484222325UL;
+
+    while (*label != '\0') {
+      hash = (hash ^ static_cast<u8>(*label++)) * 0x100000001B3UL;
+    }
+
+    return static_cast<usize>(hash ^ (hash >> 32));
+  }
+
+  /**
+   * @brief Slot a sampled block's probe starts from (blocks are a block size apart, the multiply spreads them)
+   */
+  usize sample_home(const u8* const block, const usize mask) {
+    return static_cast<usize>((reinterpret_cast<uptr>(block) * 0x9E3779B97F4A7C15UL) >> 32) & mask;
+  }
+
+  /**
+   * @brief Bit of a block in its page's sample filter
+   */
+  u64 sample_filter_bit(const u8* const block) {
+    return u64{1} << ((reinterpret_cast<uptr>(block) * 0x9E3779B97F4A7C15UL) >> 58);
+  }
+
+  /**
+   * @brief Appends a protobuf varint
+   */
+  void put_varint(std::string& out, u64 value) {
+    for (; value >= 0x80; value >>= 7) {
+      out += static_cast<char>(value | 0x80);
+    }
+
+    out += static_cast<char>(value);
+  }
+
+  /**
+   * @brief Appends a protobuf varint field
+   */
+  void put_uint(std::string& out, const u32 field, const u64 value) {
+    put_varint(out, u64{field} << 3);
+    put_varint(out, value);
+  }
+
+  /**
+   * @brief Appends a protobuf length delimited field (a string, a message or packed varints)
+   */
+  void put_bytes(std::string& out, const u32 field, const std::string& bytes) {
+    put_varint(out, u64{field} << 3 | 2);
+    put_varint(out, bytes.size());
+    out += bytes;
+  }
+
+  /**
+   * @brief String table of a pprof profile, index 0 is always the empty string
+   */
+  struct ProfileStrings {
+    std::vector<std::string> strings{""};
+
+    /**
+     * @brief Index of a string, added on first use (profiles have a handful, a scan is enough)
+     */
+    u64 index(const std::string& string) {
+      const auto found = std::find(strings.begin(), strings.end(), string);
+
+      if (found != strings.end()) {
+        return static_cast<u64>(found - strings.begin());
+      }
+
+      strings.push_back(string);
+      return strings.size() - 1;
+    }
+  };
+
+  /**
+   * @brief A pprof ValueType message: {type, unit}
+   */
+  std::string value_type(ProfileStrings& strings, const char* const type, const char* const unit) {
+    std::string message;
+    put_uint(message, 1, strings.index(type));
+    put_uint(message, 2, strings.index(unit));
+    return message;
+  }
+
+  /**
+   * @brief Executable file mapping of the process, so pprof can symbolize addresses against the binary
+   */
+  struct ProfileMapping {
+    u64 start;        //!< First address
+    u64 limit;        //!< One past the last address
+    u64 offset;       //!< Offset of start in the file
+    std::string file; //!< Path of the binary or shared object
+  };
+
+  /**
+   * @brief Executable mappings from /proc/self/maps, none where there is no such file
+   */
+  std::vector<ProfileMapping> executable_mappings() {
+    std::vector<ProfileMapping> mappings;
+
+#if defined(__linux__)
+    FILE* const maps = fopen("/proc/self/maps", "r");
+
+    if (maps == nullptr) {
+      return mappings;
+    }
+
+    char line[1024];
+    char file[1024];
+
+    while (fgets(line, sizeof(line), maps)) {
+      unsigned long start;
+      unsigned long limit;
+      unsigned long offset;
+      char permissions[5];
+
+      file[0] = '\0';
+
+      if (sscanf(line, "%lx-%lx %4s %lx %*s %*s %1023s", &start, &limit, permissions, &offset, file) < 4) {
+        continue;
+      }
+
+      if (permissions[2] == 'x' and file[0] == '/') {
+        mappings.push_back(ProfileMapping{start, limit, offset, file});
+      }
+    }
+
+    fclose(maps);
+#endif
+
+    return mappings;
+  }
+
+  /**
+   * @brief Spans shorter than this are checked inline, a call through the kernel pointer costs more than it saves
+   */
+  constexpr usize SIMD_PATTERN_THRESHOLD = 32;
+
+  /**
+   * @brief Checks that every byte in a span matches a pattern
+   */
+  using PatternKernel = bool (*)(const u8* ptr, usize extents, u8 pattern);
+
+  /**
+   * @brief Scalar pattern check, a word at a time
+   */
+  bool is_signed_as_scalar(const u8* ptr, usize extents, const u8 pattern) {
+    const u64 wide_pattern = u64{pattern} * 0x0101010101010101UL;
+
+    for (; extents >= sizeof(u64); ptr += sizeof(u64), extents -= sizeof(u64)) {
+      u64 word;
+      memcpy(&word, ptr, sizeof(u64));
+
+      if (word != wide_pattern) {
+        return false;
+      }
+    }
+
+    for (usize i = 0; i < extents; i++) {
+      if (ptr[i] != pattern) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+#if OA_HAS_X86_SIMD
+  /**
+   * @brief SSE2 pattern check (part of the x86-64 baseline), 16 bytes at a time, extents must be at least 16
+   */
+  bool is_signed_as_sse2(const u8* const ptr, const usize extents, const u8 pattern) {
+    const __m128i wide_pattern = _mm_set1_epi8(static_cast<char>(pattern));
+    usize i = 0;
+
+    for (; i + 16 <= extents; i += 16) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + i));
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, wide_pattern)) != 0xFFFF) {
+        return false;
+      }
+    }
+
+    // the tail overlaps bytes that have already been checked rather than falling back to bytes
+    if (i != extents) {
+      const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr + extents - 16));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, wide_pattern)) == 0xFFFF;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief AVX2 pattern check, 32 bytes at a time, extents must be at least 32
+   */
+  __attribute__((target("avx2"))) bool is_signed_as_avx2(const u8* const ptr, const usize extents, const u8 pattern) {
+    const __m256i wide_pattern = _mm256_set1_epi8(static_cast<char>(pattern));
+    usize i = 0;
+
+    for (; i + 32 <= extents; i += 32) {
+      const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + i));
+
+      if (static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, wide_pattern))) != 0xFFFFFFFFU) {
+        return false;
+      }
+    }
+
+    if (i != extents) {
+      const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr + extents - 32));
+      return static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, wide_pattern))) == 0xFFFFFFFFU;
+    }
+
+    return true;
+  }
+#endif
+
+  /**
+   * @brief Picks the widest pattern kernel the CPU supports (once, at start up)
+   */
+  PatternKernel select_pattern_kernel() {
+#if OA_HAS_X86_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+      return is_signed_as_avx2;
+    }
+
+    return is_signed_as_sse2;
+#else
+    return is_signed_as_scalar;
+#endif
+  }
+
+  /**
+   * @brief Pattern kernel used for spans of at least SIMD_PATTERN_THRESHOLD bytes
+   */
+  const PatternKernel pattern_kernel = select_pattern_kernel();
+}
 
 // NOLINTBEGIN(*-exception-baseclass)
 
 ObjectAllocator::ObjectAllocator(const usize obj_size, const OAConfig& src_config):
-    config{src_config}, object_size{obj_size}, page_size{0} {
+    block_infos{src_config.ObjectsPerPage_}, config{src_config}, object_size{obj_size}, page_size{0} {
+
+  // a line aligned object in a block spanning whole lines: the smallest alignment that is a multiple of both
+  if (config.CacheLineLayout_) {
+    unsigned alignment = CACHE_LINE_SIZE;
+
+    while (config.Alignment_ != 0 and alignment % config.Alignment_ != 0) {
+      alignment += CACHE_LINE_SIZE;
+    }
+
+    config.Alignment_ = alignment;
+  }
 
   // calculate intern and extern alignment
   if (config.Alignment_ != 0) {
@@ -20,17 +335,111 @@ ObjectAllocator::ObjectAllocator(const usize obj_size, const OAConfig& src_confi
 
   block_size = config.HBlockInfo_.size_ + config.PadBytes_ + object_size + config.PadBytes_ + config.InterAlignSize_;
 
+  while ((u64{1} << handle_slot_bits) < config.ObjectsPerPage_) {
+    handle_slot_bits++;
+  }
+
+  // pages are published whole to the lock-free list, there is no single bump pointer to carve from
+  config.LazyPageInit_ = config.LazyPageInit_ and not config.ConcurrentFreeList_;
+
+  // a lock-free list can't be split per page, and fullest page first needs every block of a page up front
+  if (config.ConcurrentFreeList_) {
+    config.AllocationPolicy_ = OAConfig::apLifo;
+  }
+
+  config.LazyPageInit_ = config.LazyPageInit_ and config.AllocationPolicy_ == OAConfig::apLifo;
+
+  // a lock-free free list already takes frees from any thread, and new/delete has no pages to keep to one thread
+  config.RemoteFree_ = config.RemoteFree_ and not config.ConcurrentFreeList_ and not config.UseCPPMemManager_;
+
+  // which site allocated a block is kept next to the page's bitmap, there is none without pages or unlocked
+  config.Profile_ = config.Profile_ and not config.ConcurrentFreeList_ and not config.UseCPPMemManager_;
+
+  if (config.Profile_) {
+    profile_started = idle_clock_ms();
+  }
+
+  // sampled stacks are kept against pages too
+  if (config.ConcurrentFreeList_ or config.UseCPPMemManager_) {
+    config.SampleInterval_ = 0;
+  }
+
+  if (config.SampleInterval_ != 0) {
+    sample_countdown = next_sample_countdown();
+  }
+
   page_size = sizeof(GenericObject)               // next page ptr
             + config.LeftAlignSize_               // ptr alignment
             + block_size * config.ObjectsPerPage_ // per block size
             - config.InterAlignSize_;             // intern align size - the first ones
 
+  // the last object would otherwise share its line with whatever follows the page
+  if (config.CacheLineLayout_) {
+    page_size = (page_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  }
+
   statistics.PageSize_ = page_size;
   statistics.ObjectSize_ = object_size;
 
+  if (config.PageBackend_ == OAConfig::pbMapped) {
+#if OA_HAS_MMAP
+    page_span = static_cast<usize>(sysconf(_SC_PAGESIZE));
+#else
+    throw OAException(OAException::E_NO_MEMORY, "Mapped pages are not supported on this platform");
+#endif
+
+    if (config.HugePages_ == OAConfig::hpHugeTLB) {
+      page_span = HUGE_PAGE_SIZE;
+    }
+
+    // the back pointer to the page's bookkeeping lives in the slack at the end of the span
+    while (page_span < page_size + sizeof(PageInfo*)) {
+      page_span *= 2;
+    }
+  }
+
+  if (config.ConcurrentFreeList_) {
+    try {
+      stat_stripes = new StatStripe[STAT_STRIPES]{};
+    } catch (const std::bad_alloc& err) {
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+  }
+
   // allocate first page if not using the CPPMemManager
   if (not config.UseCPPMemManager_) {
-    allocate_page();
+    try {
+      block_image = new u8[block_size]{};
+    } catch (const std::bad_alloc& err) {
+      delete[] stat_stripes;
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+
+    // sign once here, every block of every new page is then a single wide copy of it
+    u8* pos = block_image + config.HBlockInfo_.size_;
+
+    memset(pos, PAD_PATTERN, config.PadBytes_);
+    pos += config.PadBytes_;
+
+    memset(pos, UNALLOCATED_PATTERN, object_size);
+    pos += object_size;
+
+    memset(pos, PAD_PATTERN, config.PadBytes_);
+    pos += config.PadBytes_;
+
+    memset(pos, ALIGN_PATTERN, config.InterAlignSize_);
+
+    // no destructor runs for a constructor that throws, the page directory may have been grown already
+    try {
+      allocate_page();
+    } catch (...) {
+      delete[] page_directory;
+      delete[] page_starts;
+      delete[] page_table;
+      delete[] stat_stripes;
+      delete[] block_image;
+      throw;
+    }
   }
 }
 
@@ -42,20 +451,39 @@ ObjectAllocator::~ObjectAllocator() noexcept {
     page = page->Next;
     free_page(to_delete);
   }
+
+  for (usize i = 0; i < page_count; i++) {
+    delete_page_info(page_directory[i]);
+  }
+
+  delete[] page_directory;
+  delete[] page_starts;
+  delete[] page_table;
+  delete[] stat_stripes;
+  delete[] block_image;
+
+  delete[] profile_sites;
+  delete[] profile_index;
+  delete[] heap_sample_blocks;
+  delete[] heap_samples;
 }
 
-void* ObjectAllocator::Allocate(const char* label) {
+void* ObjectAllocator::Allocate(const char* label) { return allocate(label, OA_CALLER()); }
+
+void* ObjectAllocator::allocate(const char* label, const void* const caller) {
+  if (config.ConcurrentFreeList_) {
+    return allocate_concurrent(label);
+  }
+
+  // before a block is taken, adding a site can throw
+  const u32 site = config.Profile_ ? profile_site(label, caller) : 0;
+
   // if no more free blocks try to allocate a new page
 
   u8* block{nullptr};
 
   if (not config.UseCPPMemManager_) {
-    if (free_list == nullptr) {
-      allocate_page();
-    }
-
-    block = free_list;
-    free_list = as_bytes(as_list(free_list).Next);
+    block = take_block();
   } else {
     try {
       block = new u8[object_size];
@@ -74,28 +502,43 @@ void* ObjectAllocator::Allocate(const char* label) {
     statistics.ObjectsInUse_ > statistics.MostObjects_ ? statistics.ObjectsInUse_ : statistics.MostObjects_;
 
   if (not config.UseCPPMemManager_) {
-    setup_allocated_header(block - config.PadBytes_ - config.HBlockInfo_.size_, label);
-  }
+    PageInfo& info = *owner_of(block);
 
-  if (config.DebugOn_) {
-    u8* pos = block - config.PadBytes_;
+    set_in_use(info, block, true);
+    setup_allocated_header(block - config.PadBytes_ - config.HBlockInfo_.size_, label, statistics.Allocations_);
 
-    if (not config.UseCPPMemManager_) {
-      memset(pos, PAD_PATTERN, config.PadBytes_);
-      pos += config.PadBytes_;
+    if (config.Profile_) {
+      profile_allocation(info, block, site);
     }
 
-    memset(pos, ALLOCATED_PATTERN, object_size);
-    pos += object_size;
-
-    if (not config.UseCPPMemManager_) {
-      memset(pos, PAD_PATTERN, config.PadBytes_);
+    if (config.SampleInterval_ != 0 and --sample_countdown == 0) {
+      sample_block(info, block, label, caller);
     }
   }
 
+  if (config.DebugOn_) {
+    sign_allocated(block);
+  }
+
   return block;
 }
 
+void ObjectAllocator::sign_allocated(u8* const block) const {
+  u8* pos = block - config.PadBytes_;
+
+  if (not config.UseCPPMemManager_) {
+    memset(pos, PAD_PATTERN, config.PadBytes_);
+    pos += config.PadBytes_;
+  }
+
+  memset(pos, ALLOCATED_PATTERN, object_size);
+  pos += object_size;
+
+  if (not config.UseCPPMemManager_) {
+    memset(pos, PAD_PATTERN, config.PadBytes_);
+  }
+}
+
 void ObjectAllocator::Free(void* const block_void_ptr) {
   if (not block_void_ptr) {
     return;
@@ -103,6 +546,16 @@ void ObjectAllocator::Free(void* const block_void_ptr) {
 
   u8* const block = static_cast<u8*>(block_void_ptr);
 
+  if (config.ConcurrentFreeList_) {
+    free_concurrent(block);
+    return;
+  }
+
+  if (is_remote_free()) {
+    push_remote(block, block);
+    return;
+  }
+
   if (config.DebugOn_ and not config.UseCPPMemManager_) {
 
     // validate that this is a correct block boundry, throws if not
@@ -128,7 +581,18 @@ void ObjectAllocator::Free(void* const block_void_ptr) {
     delete[] block;
     return;
   } else {
+    PageInfo& info = *owner_of(block);
+
+    if (config.Profile_) {
+      profile_free(info, block);
+    }
+
+    if (info.sample_filter & sample_filter_bit(block)) {
+      forget_sample(info, block);
+    }
+
     // bookkeeping headers
+    set_in_use(info, block, false);
     setup_freed_header(block - config.PadBytes_ - config.HBlockInfo_.size_);
   }
 
@@ -136,123 +600,1904 @@ void ObjectAllocator::Free(void* const block_void_ptr) {
     memset(block_void_ptr, FREED_PATTERN, object_size);
   }
 
-  as_list(block).Next = &as_list(free_list);
-  free_list = block;
+  push_free_block(block, nullptr);
 }
 
-auto ObjectAllocator::validate_boundary(const u8* block) const -> void {
-  for (const GenericObject* page = &as_list(page_list); page; page = page->Next) {
-    const u8* const page_min = as_bytes(page);
-    const u8* const page_max = page_min + page_size;
+void ObjectAllocator::AllocateBatch(void** const out, const usize n, const char* const label) {
+  if (n == 0) {
+    return;
+  }
 
-    // skip if this is not on the page
-    if (block < page_min or block >= page_max) {
-      continue;
+  if (config.UseCPPMemManager_) {
+    for (usize i = 0; i < n; i++) {
+      try {
+        out[i] = new u8[object_size];
+      } catch (const std::bad_alloc&) {
+        for (usize j = 0; j < i; j++) {
+          delete[] static_cast<u8*>(out[j]);
+        }
+
+        throw OAException(OAException::E_NO_MEMORY, "'new[]' threw bad alloc.");
+      }
+    }
+  } else if (config.ConcurrentFreeList_) {
+    for (usize i = 0; i < n; i++) {
+      try {
+        out[i] = pop_concurrent();
+      } catch (const OAException&) {
+        for (usize j = 0; j < i; j++) {
+          push_concurrent(static_cast<u8*>(out[j]), static_cast<u8*>(out[j]));
+        }
+
+        throw;
+      }
+    }
+  } else {
+    const void* const caller = OA_CALLER();
+    const u32 site = config.Profile_ ? profile_site(label, caller) : 0;
+
+    if (n > statistics.FreeObjects_ and remote_free_list.load(std::memory_order_relaxed) != nullptr) {
+      DrainRemoteFrees();
     }
 
-    const u8* first_block =
-      page_min + config.LeftAlignSize_ + sizeof(GenericObject) + config.HBlockInfo_.size_ + config.PadBytes_;
+    // check up front so running out of pages hands nothing out
+    if (config.MaxPages_ != 0 and n > statistics.FreeObjects_) {
+      const usize pages = (n - statistics.FreeObjects_ + config.ObjectsPerPage_ - 1) / config.ObjectsPerPage_;
+
+      if (statistics.PagesInUse_ + pages > config.MaxPages_) {
+        throw OAException(OAException::E_NO_PAGES, "Out of pages");
+      }
+    }
+
+    for (usize i = 0; i < n; i++) {
+      try {
+        out[i] = take_block();
+      } catch (const OAException&) {
+        // out of memory part way, what was taken goes back on the free list
+        for (usize j = 0; j < i; j++) {
+          push_free_block(static_cast<u8*>(out[j]), nullptr);
+        }
+
+        throw;
+      }
+    }
+
+    PageInfo* info{nullptr};
 
-    // if block is not on a boundry in this page (or before the first block)
-    if (block < first_block or (block - first_block) % static_cast<std::ptrdiff_t>(block_size) != 0) {
-      throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry");
+    for (usize i = 0; i < n; i++) {
+      u8* const block = static_cast<u8*>(out[i]);
+
+      info = page_of(block, info);
+      set_in_use(*info, block, true);
+
+      if (config.Profile_) {
+        profile_allocation(*info, block, site);
+      }
+
+      if (config.SampleInterval_ != 0 and --sample_countdown == 0) {
+        sample_block(*info, block, label, caller);
+      }
+    }
+  }
+
+  if (config.ConcurrentFreeList_) {
+    stat_stripes[stat_stripe()].allocations.fetch_add(static_cast<unsigned>(n), std::memory_order_relaxed);
+  } else {
+    // Bookkeeping, once for the whole batch
+    statistics.ObjectsInUse_ += static_cast<unsigned>(n);
+    statistics.FreeObjects_ -= static_cast<unsigned>(n);
+
+    statistics.MostObjects_ =
+      statistics.ObjectsInUse_ > statistics.MostObjects_ ? statistics.ObjectsInUse_ : statistics.MostObjects_;
+  }
+
+  for (usize i = 0; i < n; i++) {
+    u8* const block = static_cast<u8*>(out[i]);
+
+    if (not config.UseCPPMemManager_ and config.HBlockInfo_.size_ != 0) {
+      const u32 alloc_num = config.ConcurrentFreeList_ ? allocation_ticket.fetch_add(1, std::memory_order_relaxed) + 1
+                                                       : statistics.Allocations_ + static_cast<u32>(i) + 1;
+      setup_allocated_header(block - config.PadBytes_ - config.HBlockInfo_.size_, label, alloc_num);
+    }
+
+    if (config.DebugOn_) {
+      sign_allocated(block);
+    }
+  }
+
+  if (not config.ConcurrentFreeList_) {
+    statistics.Allocations_ += static_cast<unsigned>(n);
+  }
+}
+
+void ObjectAllocator::FreeBatch(void* const* const in, const usize n) {
+  if (is_remote_free()) {
+    u8* first{nullptr};
+    u8* last{nullptr};
+
+    // linked up here, the whole batch is a single push
+    for (usize i = 0; i < n; i++) {
+      u8* const block = static_cast<u8*>(in[i]);
+
+      if (block == nullptr) {
+        continue;
+      }
+
+      if (last) {
+        as_list(last).Next = &as_list(block);
+      } else {
+        first = block;
+      }
+
+      last = block;
+    }
+
+    if (first) {
+      push_remote(first, last);
+    }
+
+    return;
+  }
+
+  u8* chunk[FREE_BATCH_CHUNK];
+
+  for (usize start = 0; start < n; start += FREE_BATCH_CHUNK) {
+    const usize count = n - start < FREE_BATCH_CHUNK ? n - start : FREE_BATCH_CHUNK;
+
+    for (usize i = 0; i < count; i++) {
+      chunk[i] = static_cast<u8*>(in[start + i]);
+    }
+
+    // grouping by page keeps the bookkeeping on one page at a time, and hands them back out in address order
+    std::sort(chunk, chunk + count, std::less<u8*>{});
+    free_batch_chunk(chunk, count);
+  }
+}
+
+void ObjectAllocator::free_batch_chunk(u8** blocks, usize count) {
+  // null pointers sort to the front, just like Free they are ignored
+  while (count != 0 and *blocks == nullptr) {
+    blocks++;
+    count--;
+  }
+
+  if (count == 0) {
+    return;
+  }
+
+  if (config.DebugOn_ and not config.UseCPPMemManager_) {
+    std::unique_lock<std::mutex> guard{page_lock, std::defer_lock};
+
+    if (config.ConcurrentFreeList_) {
+      guard.lock();
+    }
+
+    for (usize i = 0; i < count; i++) {
+      validate_boundary(blocks[i]);
+
+      // the chunk is sorted, so the same block twice in one batch sits right next to itself
+      if ((i != 0 and blocks[i] == blocks[i - 1])
+          or ((not config.ConcurrentFreeList_ or config.HBlockInfo_.type_ != OAConfig::hbNone)
+              and is_in_free_list(blocks[i]))) {
+        throw OAException(OAException::E_MULTIPLE_FREE, "Block has already been freed");
+      }
+
+      if (not validate_block(blocks[i])) {
+        throw OAException(OAException::E_CORRUPTED_BLOCK, "Corrupted Block");
+      }
+    }
+  }
+
+  // bookkeeping, once for the whole chunk
+  if (config.ConcurrentFreeList_) {
+    stat_stripes[stat_stripe()].deallocations.fetch_add(static_cast<unsigned>(count), std::memory_order_relaxed);
+  } else {
+    statistics.ObjectsInUse_ -= static_cast<unsigned>(count);
+    statistics.Deallocations_ += static_cast<unsigned>(count);
+    statistics.FreeObjects_ += static_cast<unsigned>(count);
+  }
+
+  if (config.UseCPPMemManager_) {
+    for (usize i = 0; i < count; i++) {
+      delete[] blocks[i];
     }
 
-    return;
+    return;
+  }
+
+  PageInfo* info{nullptr};
+
+  for (usize i = 0; i < count; i++) {
+    u8* const block = blocks[i];
+
+    if (not config.ConcurrentFreeList_) {
+      info = page_of(block, info);
+
+      if (config.Profile_) {
+        profile_free(*info, block);
+      }
+
+      if (info->sample_filter & sample_filter_bit(block)) {
+        forget_sample(*info, block);
+      }
+
+      set_in_use(*info, block, false);
+    }
+
+    setup_freed_header(block - config.PadBytes_ - config.HBlockInfo_.size_);
+
+    if (config.DebugOn_) {
+      memset(block, FREED_PATTERN, object_size);
+    }
+
+    if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+      push_free_block(block, info);
+      continue;
+    }
+
+    // thread the chunk in address order
+    if (i + 1 < count) {
+      as_list(block).Next = &as_list(blocks[i + 1]);
+    }
+  }
+
+  if (config.ConcurrentFreeList_) {
+    push_concurrent(blocks[0], blocks[count - 1]);
+    return;
+  }
+
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    return;
+  }
+
+  as_list(blocks[count - 1]).Next = &as_list(free_list);
+  free_list = blocks[0];
+}
+
+u8* ObjectAllocator::take_block() {
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    PageInfo* info = fullest_partial_page();
+
+    if (info == nullptr) {
+      if (remote_free_list.load(std::memory_order_relaxed) != nullptr) {
+        DrainRemoteFrees();
+      }
+
+      info = fullest_partial_page();
+    }
+
+    if (info == nullptr) {
+      allocate_page();
+      info = fullest_partial_page();
+    }
+
+    // the page is moved to its new bucket once the block is marked in use, but a batch takes every block before
+    // marking any, so a page left with no free block has to come off its bucket right away
+    u8* const block = info->free_blocks;
+    info->free_blocks = as_bytes(as_list(block).Next);
+
+    if (info->free_blocks == nullptr) {
+      rebucket(*info);
+    }
+
+    return block;
+  }
+
+  if (free_list == nullptr and bump_page == nullptr) {
+    // blocks other threads gave back are reused before growing a page
+    if (remote_free_list.load(std::memory_order_relaxed) != nullptr) {
+      DrainRemoteFrees();
+    }
+
+    if (free_list == nullptr) {
+      allocate_page();
+    }
+  }
+
+  // recycled blocks first, they are the most likely to still be in cache
+  if (free_list != nullptr) {
+    u8* const block = free_list;
+    free_list = as_bytes(as_list(free_list).Next);
+    return block;
+  }
+
+  return carve_block(*bump_page);
+}
+
+u8* ObjectAllocator::carve_block(PageInfo& info) {
+  u8* const block = first_block(info.page) + block_size * info.carved;
+
+  info.carved++;
+
+  if (info.carved == config.ObjectsPerPage_) {
+    bump_page = nullptr;
+  }
+
+  // the same signing allocate_page does up front, for just this block (its contents get signed by Allocate)
+  u8* const header = block - config.PadBytes_ - config.HBlockInfo_.size_;
+
+  memset(header, 0, config.HBlockInfo_.size_);
+  memset(block - config.PadBytes_, PAD_PATTERN, config.PadBytes_);
+  memset(block + object_size, PAD_PATTERN, config.PadBytes_);
+
+  if (config.DebugOn_ and info.carved != config.ObjectsPerPage_) {
+    memset(block + object_size + config.PadBytes_, ALIGN_PATTERN, config.InterAlignSize_);
+  }
+
+  return block;
+}
+
+void* ObjectAllocator::allocate_concurrent(const char* const label) {
+  u8* block{nullptr};
+
+  if (not config.UseCPPMemManager_) {
+    block = pop_concurrent();
+  } else {
+    try {
+      block = new u8[object_size];
+    } catch (const std::bad_alloc&) {
+      throw OAException(OAException::E_NO_MEMORY, "'new[]' threw bad alloc.");
+    }
+  }
+
+  // Bookkeeping, spread over stripes so the counters are not the new point of contention
+  stat_stripes[stat_stripe()].allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (not config.UseCPPMemManager_ and config.HBlockInfo_.size_ != 0) {
+    const u32 alloc_num = allocation_ticket.fetch_add(1, std::memory_order_relaxed) + 1;
+    setup_allocated_header(block - config.PadBytes_ - config.HBlockInfo_.size_, label, alloc_num);
+  }
+
+  if (config.DebugOn_) {
+    sign_allocated(block);
+  }
+
+  return block;
+}
+
+void ObjectAllocator::free_concurrent(u8* const block) {
+  if (config.DebugOn_ and not config.UseCPPMemManager_) {
+    // the page directory is only stable while holding the page lock
+    std::lock_guard<std::mutex> guard{page_lock};
+
+    validate_boundary(block);
+
+    // without a header the in use bitmap is not maintained, so only headers can tell
+    if (config.HBlockInfo_.type_ != OAConfig::hbNone and is_in_free_list(block)) {
+      throw OAException(OAException::E_MULTIPLE_FREE, "Block has already been freed");
+    }
+
+    if (not validate_block(block)) {
+      throw OAException(OAException::E_CORRUPTED_BLOCK, "Corrupted Block");
+    }
+  }
+
+  stat_stripes[stat_stripe()].deallocations.fetch_add(1, std::memory_order_relaxed);
+
+  if (config.UseCPPMemManager_) {
+    delete[] block;
+    return;
+  }
+
+  setup_freed_header(block - config.PadBytes_ - config.HBlockInfo_.size_);
+
+  if (config.DebugOn_) {
+    memset(block, FREED_PATTERN, object_size);
+  }
+
+  push_concurrent(block, block);
+}
+
+u8* ObjectAllocator::pop_concurrent() {
+  u64 head = concurrent_free_list.load(std::memory_order_acquire);
+
+  while (true) {
+    u8* const block = untag_pointer(head);
+
+    if (block == nullptr) {
+      std::lock_guard<std::mutex> guard{page_lock};
+
+      // another thread may have grown a page while we waited on the lock
+      if (untag_pointer(concurrent_free_list.load(std::memory_order_acquire)) == nullptr) {
+        allocate_page();
+      }
+
+      head = concurrent_free_list.load(std::memory_order_acquire);
+      continue;
+    }
+
+    // block may be popped (and scribbled on) by another thread right now, the tag makes the CAS fail if so
+    u8* const next = as_bytes(as_list(block).Next);
+
+    if (concurrent_free_list.compare_exchange_weak(
+          head, tag_pointer(next, head), std::memory_order_acquire, std::memory_order_acquire
+        )) {
+      return block;
+    }
+  }
+}
+
+void ObjectAllocator::push_concurrent(u8* const first, u8* const last) {
+  u64 head = concurrent_free_list.load(std::memory_order_relaxed);
+
+  do {
+    as_list(last).Next = &as_list(untag_pointer(head));
+  } while (not concurrent_free_list.compare_exchange_weak(
+    head, tag_pointer(first, head), std::memory_order_release, std::memory_order_relaxed
+  ));
+}
+
+OAHandle ObjectAllocator::AllocateHandle(const char* const label) {
+  if (config.UseCPPMemManager_ or config.ConcurrentFreeList_) {
+    throw OAException(OAException::E_NO_PAGES, "Handles need pages with an in use bitmap");
+  }
+
+  void* const block = allocate(label, OA_CALLER());
+  const OAHandle handle = HandleOf(block);
+
+  // its page's id doesn't fit in what the slot and generation leave of a handle
+  if (handle == NULL_HANDLE) {
+    Free(block);
+    throw OAException(OAException::E_NO_PAGES, "Too many pages to hand out handles");
+  }
+
+  return handle;
+}
+
+void ObjectAllocator::FreeHandle(const OAHandle handle) {
+  const u8* const block = handle_block(handle);
+
+  if (block == nullptr) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "Handle does not name a block");
+  }
+
+  if (Resolve(handle) == nullptr) {
+    throw OAException(OAException::E_MULTIPLE_FREE, "Handle is stale, its block has already been freed");
+  }
+
+  Free(const_cast<u8*>(block));
+}
+
+void* ObjectAllocator::Resolve(const OAHandle handle) const {
+  const u8* const block = handle_block(handle);
+
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  const PageInfo& info = *page_table[(handle >> (handle_slot_bits + HANDLE_GENERATION_BITS)) - 1];
+  const usize slot = (handle >> HANDLE_GENERATION_BITS) & ((u32{1} << handle_slot_bits) - 1);
+
+  if ((info.in_use[slot / 64] & (u64{1} << (slot % 64))) == 0) {
+    return nullptr;
+  }
+
+  if (generation_of(block) != (handle & ((u32{1} << HANDLE_GENERATION_BITS) - 1))) {
+    return nullptr;
+  }
+
+  return const_cast<u8*>(block);
+}
+
+OAHandle ObjectAllocator::HandleOf(const void* const object) const {
+  const u8* const block = static_cast<const u8*>(object);
+
+  if (config.UseCPPMemManager_ or config.ConcurrentFreeList_ or block == nullptr) {
+    return NULL_HANDLE;
+  }
+
+  const PageInfo* const info = find_page(block);
+
+  if (info == nullptr) {
+    return NULL_HANDLE;
+  }
+
+  const usize offset = static_cast<usize>(block - first_block(info->page));
+  const usize slot = offset / block_size;
+
+  if (block < first_block(info->page) or offset % block_size != 0
+      or (info->in_use[slot / 64] & (u64{1} << (slot % 64))) == 0) {
+    return NULL_HANDLE;
+  }
+
+  // page ids are stored plus one so that no handle is 0
+  const u32 page_bits = 32 - handle_slot_bits - HANDLE_GENERATION_BITS;
+
+  if (handle_slot_bits + HANDLE_GENERATION_BITS >= 32 or u64{info->id} + 1 >= u64{1} << page_bits) {
+    return NULL_HANDLE;
+  }
+
+  return ((info->id + 1) << (handle_slot_bits + HANDLE_GENERATION_BITS))
+       | (static_cast<u32>(slot) << HANDLE_GENERATION_BITS) | generation_of(block);
+}
+
+const u8* ObjectAllocator::handle_block(const OAHandle handle) const {
+  if (page_table == nullptr or handle_slot_bits + HANDLE_GENERATION_BITS >= 32) {
+    return nullptr;
+  }
+
+  const usize page = handle >> (handle_slot_bits + HANDLE_GENERATION_BITS);
+  const usize slot = (handle >> HANDLE_GENERATION_BITS) & ((u32{1} << handle_slot_bits) - 1);
+
+  if (page == 0 or page > page_capacity or page_table[page - 1] == nullptr or slot >= config.ObjectsPerPage_) {
+    return nullptr;
+  }
+
+  return first_block(page_table[page - 1]->page) + slot * block_size;
+}
+
+u32 ObjectAllocator::generation_of(const u8* const block) const {
+  if (config.HBlockInfo_.type_ != OAConfig::hbExtended) {
+    return 0;
+  }
+
+  const u8* const counter = block - config.PadBytes_ - config.HBlockInfo_.size_ + config.HBlockInfo_.additional_;
+
+  u16 uses;
+  memcpy(&uses, counter, sizeof(u16));
+
+  return uses & ((u32{1} << HANDLE_GENERATION_BITS) - 1);
+}
+
+u32 ObjectAllocator::DrainRemoteFrees() {
+  u8* block = remote_free_list.exchange(nullptr, std::memory_order_acquire);
+  u32 drained{0};
+  std::exception_ptr error;
+
+  while (block) {
+    // Free relinks the block onto the free list, read where the queue goes on first
+    u8* const next = as_bytes(as_list(block).Next);
+
+    try {
+      Free(block);
+      drained++;
+    } catch (const OAException& err) {
+      if (not error) {
+        error = std::current_exception();
+      }
+
+      // a block queued twice links the queue into itself (and by now into the free list)
+      if (err.code() == OAException::E_MULTIPLE_FREE) {
+        break;
+      }
+    }
+
+    block = next;
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  return drained;
+}
+
+void ObjectAllocator::SetOwnerThread() { owner_thread = std::this_thread::get_id(); }
+
+void ObjectAllocator::push_remote(u8* const first, u8* const last) {
+  u8* head = remote_free_list.load(std::memory_order_relaxed);
+
+  do {
+    as_list(last).Next = reinterpret_cast<GenericObject*>(head);
+  } while (not remote_free_list.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool ObjectAllocator::is_remote_free() const {
+  return config.RemoteFree_ and std::this_thread::get_id() != owner_thread;
+}
+
+void ObjectAllocator::rebuild_page_bookkeeping() const {
+  const usize words = bitmap_words();
+  const usize tail_bits = config.ObjectsPerPage_ % 64;
+
+  // everything is in use until found on the free list
+  for (usize i = 0; i < page_count; i++) {
+    PageInfo& info = *page_directory[i];
+
+    for (usize word = 0; word < words; word++) {
+      info.in_use[word] = ~u64{0};
+    }
+
+    if (tail_bits != 0) {
+      info.in_use[words - 1] = (u64{1} << tail_bits) - 1;
+    }
+
+    info.live = config.ObjectsPerPage_;
+  }
+
+  const u8* free = untag_pointer(concurrent_free_list.load(std::memory_order_acquire));
+
+  for (; free; free = as_bytes(as_list(free).Next)) {
+    PageInfo* const info = owner_of(free);
+    const usize index = block_index(*info, free);
+
+    info->in_use[index / 64] &= ~(u64{1} << (index % 64));
+    info->live--;
+  }
+}
+
+void ObjectAllocator::snapshot_concurrent_stats() const {
+  unsigned allocations{0};
+  unsigned deallocations{0};
+
+  for (usize i = 0; i < STAT_STRIPES; i++) {
+    allocations += stat_stripes[i].allocations.load(std::memory_order_relaxed);
+    deallocations += stat_stripes[i].deallocations.load(std::memory_order_relaxed);
+  }
+
+  // statistics keeps the page level numbers, FreeObjects_ there is the number of blocks the pages hold
+  const unsigned most_objects = concurrent_stats.MostObjects_;
+
+  concurrent_stats = statistics;
+  concurrent_stats.Allocations_ = allocations;
+  concurrent_stats.Deallocations_ = deallocations;
+  concurrent_stats.ObjectsInUse_ = allocations - deallocations;
+  concurrent_stats.FreeObjects_ = statistics.FreeObjects_ - concurrent_stats.ObjectsInUse_;
+
+  // can only be sampled (here and on every page growth) without a shared counter
+  concurrent_stats.MostObjects_ =
+    concurrent_stats.ObjectsInUse_ > most_objects ? concurrent_stats.ObjectsInUse_ : most_objects;
+}
+
+usize ObjectAllocator::stat_stripe() {
+  static std::atomic<usize> next_stripe{0};
+  thread_local const usize stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % STAT_STRIPES;
+
+  return stripe;
+}
+
+u64 ObjectAllocator::tag_pointer(const u8* const ptr, const u64 previous) {
+  const u64 tag = (previous >> TAG_POINTER_BITS) + 1;
+  return (tag << TAG_POINTER_BITS) | static_cast<u64>(reinterpret_cast<uptr>(ptr));
+}
+
+u8* ObjectAllocator::untag_pointer(const u64 tagged) {
+  return reinterpret_cast<u8*>(static_cast<uptr>(tagged & ((u64{1} << TAG_POINTER_BITS) - 1)));
+}
+
+auto ObjectAllocator::validate_boundary(const u8* block) const -> void {
+  const PageInfo* const info = find_page(block);
+
+  if (info == nullptr) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry, not on any pages");
+  }
+
+  const u8* const first = first_block(info->page);
+
+  // if block is not on a boundry in this page (or before the first block)
+  if (block < first or (block - first) % static_cast<std::ptrdiff_t>(block_size) != 0) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry");
+  }
+}
+
+bool ObjectAllocator::Owns(const void* const ptr) const { return find_page(static_cast<const u8*>(ptr)) != nullptr; }
+
+usize ObjectAllocator::PageAlignment() const {
+  if (config.UseCPPMemManager_) {
+    return alignof(std::max_align_t);
+  }
+
+  // pages are aligned on their span where there is one, otherwise new[] aligns them (by hand on a line for the layout)
+  if (page_span != 0) {
+    return page_span;
+  }
+
+  return config.CacheLineLayout_ ? CACHE_LINE_SIZE : alignof(std::max_align_t);
+}
+
+ObjectAllocator::PageInfo* ObjectAllocator::find_page(const u8* const ptr) const {
+  if (page_count == 0) {
+    return nullptr;
+  }
+
+  // branch free binary search for the last page that starts at or before ptr, the only candidate (with freed blocks
+  // coming back in random order every branch would be a coin toss)
+  const u8* const* base = page_starts;
+  usize count = page_count;
+
+  while (count > 1) {
+    const usize half = count / 2;
+    base = base[half] <= ptr ? base + half : base;
+    count -= half;
+  }
+
+  if (*base > ptr or ptr >= *base + page_size) {
+    return nullptr;
+  }
+
+  return page_directory[base - page_starts];
+}
+
+ObjectAllocator::PageInfo* ObjectAllocator::owner_of(const u8* const ptr) const {
+  if (page_span == 0) {
+    return find_page(ptr);
+  }
+
+  const u8* const page = reinterpret_cast<const u8*>(reinterpret_cast<uptr>(ptr) & ~static_cast<uptr>(page_span - 1));
+  return back_pointer(page);
+}
+
+ObjectAllocator::PageInfo*& ObjectAllocator::back_pointer(const u8* const page) const {
+  return *reinterpret_cast<PageInfo**>(const_cast<u8*>(page) + page_span - sizeof(PageInfo*));
+}
+
+u8* ObjectAllocator::map_page() const {
+  if (page_span == 0) {
+    try {
+      if (not config.CacheLineLayout_) {
+        return new u8[page_size];
+      }
+
+      // new[] only aligns on max_align_t, over-allocate by a line and keep the offset in the byte before the page
+      u8* const memory = new u8[page_size + CACHE_LINE_SIZE];
+      u8* const page = reinterpret_cast<u8*>((reinterpret_cast<uptr>(memory) + CACHE_LINE_SIZE) & ~(CACHE_LINE_SIZE - 1));
+
+      page[-1] = static_cast<u8>(page - memory);
+      return page;
+    } catch (const std::bad_alloc& err) {
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+  }
+
+#if OA_HAS_MMAP
+  const usize os_page = static_cast<usize>(sysconf(_SC_PAGESIZE));
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  usize huge_page = os_page;
+
+  #ifdef MAP_HUGETLB
+  if (config.HugePages_ == OAConfig::hpHugeTLB) {
+    flags |= MAP_HUGETLB;
+    huge_page = HUGE_PAGE_SIZE;
+  }
+  #endif
+
+  // mmap only aligns on (huge) pages, reserve twice the span and trim it down to an aligned one
+  usize reserve = page_span > huge_page ? page_span * 2 : page_span;
+  void* memory = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+  #ifdef MAP_HUGETLB
+  if (memory == MAP_FAILED and (flags & MAP_HUGETLB)) {
+    // no huge pages reserved with the kernel, transparent huge pages are the next best thing
+    flags &= ~MAP_HUGETLB;
+    reserve = page_span > os_page ? page_span * 2 : page_span;
+    memory = mmap(nullptr, reserve, PROT_READ | PROT_WRITE, flags, -1, 0);
+  }
+  #endif
+
+  if (memory == MAP_FAILED) {
+    throw OAException(OAException::E_NO_MEMORY, "mmap failed");
+  }
+
+  u8* const start = static_cast<u8*>(memory);
+  u8* const page = reinterpret_cast<u8*>((reinterpret_cast<uptr>(start) + page_span - 1) & ~(page_span - 1));
+
+  if (page != start) {
+    munmap(start, static_cast<usize>(page - start));
+  }
+
+  if (start + reserve != page + page_span) {
+    munmap(page + page_span, static_cast<usize>(start + reserve - (page + page_span)));
+  }
+
+  #ifdef MADV_HUGEPAGE
+  if (config.HugePages_ != OAConfig::hpNone and not(flags & MAP_HUGETLB)) {
+    madvise(page, page_span, MADV_HUGEPAGE);
+  }
+  #endif
+
+  return page;
+#else
+  throw OAException(OAException::E_NO_MEMORY, "Mapped pages are not supported on this platform");
+#endif
+}
+
+void ObjectAllocator::unmap_page(u8* const page) const {
+  if (page_span == 0) {
+    delete[] (config.CacheLineLayout_ ? page - page[-1] : page);
+    return;
+  }
+
+#if OA_HAS_MMAP
+  munmap(page, page_span);
+#endif
+}
+
+void ObjectAllocator::reserve_page_directory() {
+  if (page_count < page_capacity) {
+    return;
+  }
+
+  const usize capacity = page_capacity == 0 ? 8 : page_capacity * 2;
+  PageInfo** directory{nullptr};
+  const u8** starts{nullptr};
+  PageInfo** table{nullptr};
+
+  try {
+    directory = new PageInfo*[capacity];
+    starts = new const u8*[capacity];
+    table = new PageInfo*[capacity]{};
+  } catch (const std::bad_alloc& err) {
+    delete[] directory;
+    delete[] starts;
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  if (page_count != 0) {
+    memcpy(directory, page_directory, page_count * sizeof(PageInfo*));
+    memcpy(starts, page_starts, page_count * sizeof(const u8*));
+  }
+
+  // ids stay below the page count (the lowest free one is taken), so the table is full when the directory is
+  if (page_capacity != 0) {
+    memcpy(table, page_table, page_capacity * sizeof(PageInfo*));
+  }
+
+  delete[] page_directory;
+  delete[] page_starts;
+  delete[] page_table;
+  page_directory = directory;
+  page_starts = starts;
+  page_table = table;
+  page_capacity = capacity;
+}
+
+usize ObjectAllocator::bitmap_words() const { return (config.ObjectsPerPage_ + 63) / 64; }
+
+usize ObjectAllocator::block_index(const PageInfo& info, const u8* const block) const {
+  return static_cast<usize>(block - first_block(info.page)) / block_size;
+}
+
+void ObjectAllocator::set_in_use(const u8* const block, const bool in_use) { set_in_use(*owner_of(block), block, in_use); }
+
+void ObjectAllocator::set_in_use(PageInfo& info, const u8* const block, const bool in_use) {
+  const usize index = block_index(info, block);
+  const u64 bit = u64{1} << (index % 64);
+
+  if (in_use) {
+    info.in_use[index / 64] |= bit;
+
+    // a retained page is being reused as is
+    if (info.live++ == 0 and info.empty_since != 0) {
+      info.empty_since = 0;
+      statistics.RetainedPages_--;
+    }
+
+    if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+      rebucket(info);
+    }
+  } else {
+    info.in_use[index / 64] &= ~bit;
+    info.live--;
+  }
+}
+
+void ObjectAllocator::push_free_block(u8* const block, PageInfo* info) {
+  if (config.AllocationPolicy_ == OAConfig::apLifo) {
+    as_list(block).Next = &as_list(free_list);
+    free_list = block;
+    return;
+  }
+
+  if (info == nullptr) {
+    info = owner_of(block);
+  }
+
+  as_list(block).Next = reinterpret_cast<GenericObject*>(info->free_blocks);
+  info->free_blocks = block;
+  rebucket(*info);
+}
+
+void ObjectAllocator::rebucket(PageInfo& info) {
+  // live is below ObjectsPerPage_ whenever there is a free block, so pages in use land on the buckets right above
+  // EMPTY_BUCKET, up to EMPTY_BUCKET + OCCUPANCY_BUCKETS
+  u32 bucket{0};
+
+  if (info.free_blocks) {
+    bucket = info.live == 0 ? EMPTY_BUCKET : EMPTY_BUCKET + 1 + info.live * OCCUPANCY_BUCKETS / config.ObjectsPerPage_;
+  }
+
+  if (bucket == info.bucket) {
+    return;
+  }
+
+  unlink_partial(info);
+
+  if (bucket != 0) {
+    info.prev_partial = nullptr;
+    info.next_partial = partial_pages[bucket];
+
+    if (info.next_partial) {
+      info.next_partial->prev_partial = &info;
+    }
+
+    partial_pages[bucket] = &info;
+    partial_mask |= u32{1} << bucket;
+    info.bucket = bucket;
+  }
+}
+
+void ObjectAllocator::unlink_partial(PageInfo& info) {
+  if (info.bucket == 0) {
+    return;
+  }
+
+  if (info.prev_partial) {
+    info.prev_partial->next_partial = info.next_partial;
+  } else {
+    partial_pages[info.bucket] = info.next_partial;
+  }
+
+  if (info.next_partial) {
+    info.next_partial->prev_partial = info.prev_partial;
+  }
+
+  if (partial_pages[info.bucket] == nullptr) {
+    partial_mask &= ~(u32{1} << info.bucket);
+  }
+
+  info.prev_partial = nullptr;
+  info.next_partial = nullptr;
+  info.bucket = 0;
+}
+
+ObjectAllocator::PageInfo* ObjectAllocator::fullest_partial_page() const {
+  if (partial_mask == 0) {
+    return nullptr;
+  }
+
+  u32 bucket = EMPTY_BUCKET + OCCUPANCY_BUCKETS;
+
+  while ((partial_mask & (u32{1} << bucket)) == 0) {
+    bucket--;
+  }
+
+  return partial_pages[bucket];
+}
+
+ObjectAllocator::PageInfo* ObjectAllocator::page_of(const u8* const block, PageInfo* const hint) const {
+  if (hint and block >= hint->page and block < hint->page + page_size) {
+    return hint;
+  }
+
+  return owner_of(block);
+}
+
+void ObjectAllocator::register_page(PageInfo* const info) {
+  // shift every page after this one up a slot to keep the directory sorted
+  usize index = page_count;
+
+  while (index > 0 and page_starts[index - 1] > info->page) {
+    page_directory[index] = page_directory[index - 1];
+    page_starts[index] = page_starts[index - 1];
+    index--;
+  }
+
+  page_directory[index] = info;
+  page_starts[index] = info->page;
+  page_count++;
+
+  // the lowest free id, at most the number of pages there were
+  u32 id{0};
+
+  while (page_table[id] != nullptr) {
+    id++;
+  }
+
+  info->id = id;
+  page_table[id] = info;
+
+  if (page_span != 0) {
+    back_pointer(info->page) = info;
+  }
+}
+
+void ObjectAllocator::delete_page_info(PageInfo* const info) {
+  delete[] info->in_use;
+  delete[] info->sites;
+  delete info;
+}
+
+u8* ObjectAllocator::first_block(u8* const page) const {
+  return page + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+}
+
+const u8* ObjectAllocator::first_block(const u8* const page) const {
+  return page + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+}
+
+u32 ObjectAllocator::DumpMemoryInUse(const DUMPCALLBACK callback) const {
+  u32 in_use{0};
+
+  if (config.ConcurrentFreeList_) {
+    rebuild_page_bookkeeping();
+  }
+
+  // the in-use bitmap answers directly, free blocks are skipped a word (64 blocks) at a time
+  for (const GenericObject* page = &as_list(page_list); page; page = page->Next) {
+    const PageInfo& info = *owner_of(as_bytes(page));
+    const u8* const first = first_block(info.page);
+
+    for (usize word = 0; word < bitmap_words(); word++) {
+      for (u64 bits = info.in_use[word]; bits != 0; bits &= bits - 1) {
+        in_use++;
+        callback(first + (word * 64 + lowest_bit(bits)) * block_size, object_size);
+      }
+    }
+  }
+
+  return in_use;
+}
+
+ObjectAllocator::PageIterator::PageIterator(const ObjectAllocator& oa, const usize index): oa{&oa}, index{index} {}
+
+ObjectAllocator::LivePage ObjectAllocator::PageIterator::operator*() const {
+  const PageInfo& info = *oa->page_directory[index];
+
+  return {oa->first_block(info.page), oa->block_size, info.carved, info.live, info.in_use};
+}
+
+auto ObjectAllocator::PageIterator::operator++() -> PageIterator& {
+  index++;
+  return *this;
+}
+
+bool ObjectAllocator::PageIterator::operator==(const PageIterator& rhs) const {
+  return oa == rhs.oa and index == rhs.index;
+}
+
+bool ObjectAllocator::PageIterator::operator!=(const PageIterator& rhs) const { return not(*this == rhs); }
+
+auto ObjectAllocator::Pages() const -> PageRange { return {PageIterator(*this, 0), PageIterator(*this, page_count)}; }
+
+u32 ObjectAllocator::ValidatePages(const VALIDATECALLBACK callback) const {
+  if (not config.DebugOn_ or config.PadBytes_ == 0) {
+    return 0;
+  }
+
+  const GenericObject* page = &as_list(page_list);
+  u32 invalid_count{0};
+
+  while (page) {
+    const u8* first_block =
+      as_bytes(page) + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+
+    // blocks the bump pointer has not reached yet have never been signed
+    const usize carved = owner_of(as_bytes(page))->carved;
+
+    for (usize i = 0; i < carved; i++) {
+      const u8* const block = first_block + block_size * i;
+      if (not validate_block(block)) {
+        callback(block, object_size);
+        invalid_count++;
+      }
+    };
+
+    page = page->Next;
+  }
+
+  return invalid_count;
+}
+
+void ObjectAllocator::free_page(u8* const page) {
+  // no invariants need to be preserved if there is no exernal header (heap-allocated)
+  if (config.HBlockInfo_.type_ != OAConfig::hbExternal) {
+    unmap_page(page);
+    return;
+  }
+
+  u8* const first_header = page + sizeof(GenericObject) + config.LeftAlignSize_;
+  const usize carved = owner_of(page)->carved;
+  const std::unique_lock<std::mutex> guard = external_guard();
+
+  // headers past the bump pointer were never initialised
+  for (usize i = 0; i < carved; i++) {
+    MemBlockInfo* const info = *reinterpret_cast<MemBlockInfo**>(first_header + i * block_size);
+
+    if (info != nullptr) {
+      block_infos.Release(info);
+    }
+  }
+
+  unmap_page(page);
+}
+
+u32 ObjectAllocator::FreeEmptyPages() {
+  u32 freed{0};
+
+  if (remote_free_list.load(std::memory_order_relaxed) != nullptr) {
+    DrainRemoteFrees();
+  }
+
+  // the lock-free list is treated as a plain one for the duration (no Allocate/Free may be running)
+  if (config.ConcurrentFreeList_) {
+    rebuild_page_bookkeeping();
+    free_list = untag_pointer(concurrent_free_list.load(std::memory_order_acquire));
+  }
+
+  // mark every empty page up front (live counters make this O(pages)) so the free list is walked at most once
+  statistics.RetainedPages_ = static_cast<unsigned>(mark_pages_to_release());
+
+  usize carved{0};
+
+  for (usize i = 0; i < page_count; i++) {
+    PageInfo& info = *page_directory[i];
+
+    if (info.released) {
+      freed++;
+      carved += info.carved;
+
+      // blocks never carved are counted as free objects, but are not on the free list
+      statistics.FreeObjects_ -= config.ObjectsPerPage_ - info.carved;
+
+      if (bump_page == &info) {
+        bump_page = nullptr;
+      }
+    }
+  }
+
+  if (freed != 0) {
+    release_marked_pages(carved);
+  }
+
+  if (config.ConcurrentFreeList_) {
+    concurrent_free_list.store(
+      tag_pointer(free_list, concurrent_free_list.load(std::memory_order_relaxed)), std::memory_order_release
+    );
+    free_list = nullptr;
+  }
+
+  {
+    const std::unique_lock<std::mutex> guard = external_guard();
+    block_infos.Trim();
+  }
+
+  return freed;
+}
+
+usize ObjectAllocator::GetProfile(OAProfileEntry* const out, const usize capacity, const PROFILE_GROUPING grouping)
+  const {
+  if (profile_site_count == 0) {
+    return 0;
+  }
+
+  OAProfileEntry* rows{nullptr};
+
+  try {
+    rows = new OAProfileEntry[profile_site_count];
+  } catch (const std::bad_alloc& err) {
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  const usize count = profile_rows(rows, grouping);
+
+  std::stable_sort(rows, rows + count, [](const OAProfileEntry& a, const OAProfileEntry& b) {
+    return a.live_bytes != b.live_bytes ? a.live_bytes > b.live_bytes : a.allocations > b.allocations;
+  });
+
+  std::copy(rows, rows + (count < capacity ? count : capacity), out);
+  delete[] rows;
+
+  return count;
+}
+
+std::string ObjectAllocator::ProfileReport(const PROFILE_GROUPING grouping) const {
+  OAProfileEntry* rows{nullptr};
+  usize count{0};
+
+  try {
+    rows = new OAProfileEntry[profile_site_count + 1];
+    count = GetProfile(rows, profile_site_count, grouping);
+  } catch (const std::bad_alloc& err) {
+    delete[] rows;
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  } catch (const OAException&) {
+    delete[] rows;
+    throw;
+  }
+
+  char line[256];
+  std::string report;
+
+  snprintf(
+    line,
+    sizeof(line),
+    "%-24s %-18s %12s %12s %12s %12s %12s\n",
+    "Label",
+    grouping == pgCallSite ? "Call site" : "",
+    "Live objects",
+    "Live bytes",
+    "Allocations",
+    "Frees",
+    "Allocs/s"
+  );
+  report += line;
+
+  for (usize i = 0; i < count; i++) {
+    const OAProfileEntry& row = rows[i];
+    char caller[32] = "";
+
+    if (grouping == pgCallSite) {
+      snprintf(caller, sizeof(caller), "%p", row.caller);
+    }
+
+    snprintf(
+      line,
+      sizeof(line),
+      "%-24.24s %-18s %12llu %12llu %12llu %12llu %12.1f\n",
+      row.label ? row.label : "(none)",
+      caller,
+      static_cast<unsigned long long>(row.live_objects),
+      static_cast<unsigned long long>(row.live_bytes),
+      static_cast<unsigned long long>(row.allocations),
+      static_cast<unsigned long long>(row.deallocations),
+      row.allocations_per_second
+    );
+    report += line;
+  }
+
+  delete[] rows;
+  return report;
+}
+
+usize ObjectAllocator::profile_rows(OAProfileEntry* const rows, const PROFILE_GROUPING grouping) const {
+  const double seconds = static_cast<double>(idle_clock_ms() - profile_started + 1) / 1000.0;
+  usize count{0};
+
+  for (u32 i = 0; i < profile_site_count; i++) {
+    const ProfileSite& site = profile_sites[i];
+    OAProfileEntry* row{nullptr};
+
+    // sites are few, merging them by label is a scan of the rows so far
+    if (grouping == pgLabel) {
+      for (usize j = 0; j < count and row == nullptr; j++) {
+        const bool both_none = rows[j].label == nullptr and site.label == nullptr;
+        const bool same = rows[j].label and site.label and strcmp(rows[j].label, site.label) == 0;
+
+        if (both_none or same) {
+          row = &rows[j];
+        }
+      }
+    }
+
+    if (row == nullptr) {
+      row = &rows[count++];
+      *row = OAProfileEntry{site.label, grouping == pgCallSite ? site.caller : nullptr, 0, 0, 0, 0, 0.0};
+    }
+
+    row->allocations += site.allocations;
+    row->deallocations += site.deallocations;
+    row->live_objects = row->allocations - row->deallocations;
+    row->live_bytes = row->live_objects * object_size;
+    row->allocations_per_second = static_cast<double>(row->allocations) / seconds;
+  }
+
+  return count;
+}
+
+u32 ObjectAllocator::profile_site(const char* const label, const void* const caller) {
+  const usize hash = profile_hash(label, caller);
+
+  if (profile_index_size != 0) {
+    for (usize slot = hash & (profile_index_size - 1); profile_index[slot] != 0;
+         slot = (slot + 1) & (profile_index_size - 1)) {
+      const ProfileSite& site = profile_sites[profile_index[slot] - 1];
+
+      // the same pointer can hold another label by now (a reused buffer), so the contents are checked too
+      if (site.key == label and site.caller == caller
+          and (label == nullptr or strcmp(site.label, label) == 0)) {
+        return profile_index[slot] - 1;
+      }
+    }
+  }
+
+  try {
+    if (profile_site_count == profile_site_capacity) {
+      const u32 capacity = profile_site_capacity ? profile_site_capacity * 2 : 16;
+      ProfileSite* const sites = new ProfileSite[capacity];
+
+      std::copy(profile_sites, profile_sites + profile_site_count, sites);
+      delete[] profile_sites;
+      profile_sites = sites;
+      profile_site_capacity = capacity;
+    }
+
+    // kept at most half full, rehashed from the sites (their order is their index)
+    if ((profile_site_count + 1) * 2 > profile_index_size) {
+      const usize size = profile_index_size ? profile_index_size * 2 : 32;
+      u32* const index = new u32[size]{};
+
+      delete[] profile_index;
+      profile_index = index;
+      profile_index_size = size;
+
+      for (u32 i = 0; i < profile_site_count; i++) {
+        usize slot = profile_hash(profile_sites[i].key, profile_sites[i].caller) & (size - 1);
+
+        while (index[slot] != 0) {
+          slot = (slot + 1) & (size - 1);
+        }
+
+        index[slot] = i + 1;
+      }
+    }
+
+    profile_sites[profile_site_count] = ProfileSite{label, block_infos.InternLabel(label), caller, 0, 0};
+  } catch (const std::bad_alloc& err) {
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  usize slot = hash & (profile_index_size - 1);
+
+  while (profile_index[slot] != 0) {
+    slot = (slot + 1) & (profile_index_size - 1);
+  }
+
+  profile_index[slot] = profile_site_count + 1;
+
+  return profile_site_count++;
+}
+
+void ObjectAllocator::profile_allocation(PageInfo& info, const u8* const block, const u32 site) {
+  info.sites[block_index(info, block)] = site;
+  profile_sites[site].allocations++;
+}
+
+void ObjectAllocator::profile_free(PageInfo& info, const u8* const block) {
+  profile_sites[info.sites[block_index(info, block)]].deallocations++;
+}
+
+bool ObjectAllocator::WriteHeapProfile(const char* const path) const {
+  ProfileStrings strings;
+  std::string profile;
+
+  put_bytes(profile, 1, value_type(strings, "inuse_objects", "count"));
+  put_bytes(profile, 1, value_type(strings, "inuse_space", "bytes"));
+
+  // every frame is a return address, one back lands on the call instruction (what pprof should attribute)
+  std::vector<u64> addresses;
+
+  for (usize i = 0; i < heap_sample_capacity; i++) {
+    const HeapSample& sample = heap_samples[i];
+
+    for (u32 frame = 0; heap_sample_blocks[i] and frame < sample.depth; frame++) {
+      addresses.push_back(reinterpret_cast<uptr>(sample.stack[frame]) - 1);
+    }
+  }
+
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+  const auto location_id = [&addresses](const void* const frame) {
+    const u64 address = reinterpret_cast<uptr>(frame) - 1;
+    return static_cast<u64>(std::lower_bound(addresses.begin(), addresses.end(), address) - addresses.begin()) + 1;
+  };
+
+  // each sample stands for SampleInterval_ allocations on average
+  const u64 weight = config.SampleInterval_;
+
+  for (usize i = 0; i < heap_sample_capacity; i++) {
+    const HeapSample& sample = heap_samples[i];
+
+    if (heap_sample_blocks[i] == nullptr) {
+      continue;
+    }
+
+    std::string locations;
+    std::string values;
+    std::string message;
+
+    for (u32 frame = 0; frame < sample.depth; frame++) {
+      put_varint(locations, location_id(sample.stack[frame]));
+    }
+
+    put_varint(values, weight);
+    put_varint(values, weight * object_size);
+
+    put_bytes(message, 1, locations);
+    put_bytes(message, 2, values);
+
+    if (sample.label) {
+      std::string label;
+      put_uint(label, 1, strings.index("label"));
+      put_uint(label, 2, strings.index(sample.label));
+      put_bytes(message, 3, label);
+    }
+
+    put_bytes(profile, 2, message);
+  }
+
+  const std::vector<ProfileMapping> mappings = executable_mappings();
+
+  for (usize i = 0; i < mappings.size(); i++) {
+    std::string message;
+    put_uint(message, 1, i + 1);
+    put_uint(message, 2, mappings[i].start);
+    put_uint(message, 3, mappings[i].limit);
+    put_uint(message, 4, mappings[i].offset);
+    put_uint(message, 5, strings.index(mappings[i].file));
+    put_bytes(profile, 3, message);
+  }
+
+  for (usize i = 0; i < addresses.size(); i++) {
+    std::string message;
+    put_uint(message, 1, i + 1);
+
+    for (usize m = 0; m < mappings.size(); m++) {
+      if (addresses[i] >= mappings[m].start and addresses[i] < mappings[m].limit) {
+        put_uint(message, 2, m + 1);
+        break;
+      }
+    }
+
+    put_uint(message, 3, addresses[i]);
+    put_bytes(profile, 4, message);
+  }
+
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+
+  put_uint(profile, 9, static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()));
+  put_bytes(profile, 11, value_type(strings, "space", "bytes"));
+  put_uint(profile, 12, weight * object_size);
+
+  // last, every string has been added by now
+  for (const std::string& string : strings.strings) {
+    put_bytes(profile, 6, string);
+  }
+
+  FILE* const file = fopen(path, "wb");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  const bool written = fwrite(profile.data(), 1, profile.size(), file) == profile.size();
+  return fclose(file) == 0 and written;
+}
+
+usize ObjectAllocator::SampledObjects() const { return heap_sample_count; }
+
+usize ObjectAllocator::InternedLabels() const { return block_infos.LabelCount(); }
+
+OA_COLD void ObjectAllocator::sample_block(
+  PageInfo& info,
+  const u8* const block,
+  const char* const label,
+  const void* const caller
+) {
+  sample_countdown = next_sample_countdown();
+
+  // a sample is only a hint, running out of memory for one must not fail the allocation
+  const char* interned{nullptr};
+
+  try {
+    interned = block_infos.InternLabel(label);
+  } catch (const OAException&) {
+    return;
+  }
+
+  HeapSample* const sample = insert_sample(info, block);
+
+  if (sample == nullptr) {
+    MemBlockInfoPool::ReleaseLabel(interned);
+    return;
+  }
+
+  sample->label = interned;
+
+#if OA_HAS_BACKTRACE
+  sample->depth = static_cast<u32>(backtrace(sample->stack, HEAP_SAMPLE_DEPTH));
+#else
+  sample->stack[0] = const_cast<void*>(caller);
+  sample->depth = caller ? 1 : 0;
+#endif
+
+  static_cast<void>(caller);
+}
+
+auto ObjectAllocator::insert_sample(PageInfo& info, const u8* const block) -> HeapSample* {
+  // kept at most half full
+  if ((heap_sample_count + 1) * 2 > heap_sample_capacity) {
+    const usize old_capacity = heap_sample_capacity;
+    const u8** const old_blocks = heap_sample_blocks;
+    HeapSample* const old_samples = heap_samples;
+    const usize capacity = old_capacity ? old_capacity * 2 : 64;
+
+    try {
+      heap_sample_blocks = new const u8*[capacity]{};
+    } catch (const std::bad_alloc&) {
+      heap_sample_blocks = old_blocks;
+      return nullptr;
+    }
+
+    try {
+      heap_samples = new HeapSample[capacity]{};
+    } catch (const std::bad_alloc&) {
+      delete[] heap_sample_blocks;
+      heap_sample_blocks = old_blocks;
+      heap_samples = old_samples;
+      return nullptr;
+    }
+
+    heap_sample_capacity = capacity;
+
+    for (usize i = 0; i < old_capacity; i++) {
+      if (old_blocks[i]) {
+        const usize slot = sample_slot(old_blocks[i]);
+        heap_sample_blocks[slot] = old_blocks[i];
+        heap_samples[slot] = old_samples[i];
+      }
+    }
+
+    delete[] old_blocks;
+    delete[] old_samples;
+  }
+
+  const usize slot = sample_slot(block);
+
+  heap_sample_blocks[slot] = block;
+  heap_samples[slot] = HeapSample{nullptr, 0, {}};
+  heap_sample_count++;
+  info.samples++;
+  info.sample_filter |= sample_filter_bit(block);
+
+  return &heap_samples[slot];
+}
+
+void ObjectAllocator::forget_sample(PageInfo& info, const u8* const block) {
+  usize hole = sample_slot(block);
+
+  if (heap_sample_blocks[hole] == nullptr) {
+    return;
+  }
+
+  heap_sample_count--;
+  MemBlockInfoPool::ReleaseLabel(heap_samples[hole].label);
+
+  // bits can't be taken out (others may share them), the filter starts over once the page has no samples
+  if (--info.samples == 0) {
+    info.sample_filter = 0;
+  }
+
+  // backward shift deletion: pull up every later entry of the run that may not sit past the hole
+  const usize mask = heap_sample_capacity - 1;
+
+  for (usize slot = (hole + 1) & mask; heap_sample_blocks[slot]; slot = (slot + 1) & mask) {
+    const usize home = sample_home(heap_sample_blocks[slot], mask);
+
+    if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+      heap_sample_blocks[hole] = heap_sample_blocks[slot];
+      heap_samples[hole] = heap_samples[slot];
+      hole = slot;
+    }
+  }
+
+  heap_sample_blocks[hole] = nullptr;
+  heap_samples[hole].label = nullptr;
+}
+
+usize ObjectAllocator::sample_slot(const u8* const block) const {
+  const usize mask = heap_sample_capacity - 1;
+  usize slot = sample_home(block, mask);
+
+  while (heap_sample_blocks[slot] != nullptr and heap_sample_blocks[slot] != block) {
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+u64 ObjectAllocator::next_sample_countdown() {
+  if (config.SampleInterval_ <= 1) {
+    return 1;
+  }
+
+  sample_random ^= sample_random << 13;
+  sample_random ^= sample_random >> 7;
+  sample_random ^= sample_random << 17;
+
+  // uniform in (0, 1], then inverted into a geometric gap of mean SampleInterval_
+  const double uniform = (static_cast<double>(sample_random >> 11) + 1.0) / 9007199254740992.0;
+
+  return 1 + static_cast<u64>(std::log(uniform) / std::log1p(-1.0 / config.SampleInterval_));
+}
+
+u32 ObjectAllocator::Compact(const u32 budget, const RELOCATECALLBACK relocate, void* const context) {
+  if (config.UseCPPMemManager_ or config.ConcurrentFreeList_ or budget == 0) {
+    return 0;
+  }
+
+  if (remote_free_list.load(std::memory_order_relaxed) != nullptr) {
+    DrainRemoteFrees();
+  }
+
+  // an object to move and the block claimed for it
+  struct Move {
+    u8* from;
+    u8* to;
+    PageInfo* from_page;
+  };
+
+  const usize most = budget < statistics.ObjectsInUse_ ? budget : statistics.ObjectsInUse_;
+  PageInfo** order{nullptr};
+  Move* moves{nullptr};
+
+  try {
+    order = new PageInfo*[page_count];
+    moves = new Move[most];
+  } catch (const std::bad_alloc& err) {
+    delete[] order;
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  // pages with objects in use, sparsest first: objects move from the front to the back
+  usize count{0};
+
+  for (usize i = 0; i < page_count; i++) {
+    if (page_directory[i]->live != 0) {
+      order[count++] = page_directory[i];
+    }
+  }
+
+  std::stable_sort(order, order + count, [](const PageInfo* a, const PageInfo* b) { return a->live < b->live; });
+
+  // free blocks on the pages after the current source, up to the current destination
+  usize room{0};
+
+  for (usize i = 1; i < count; i++) {
+    room += order[i]->carved - order[i]->live;
+  }
+
+  // every destination is claimed (marked in use) first, and only written to once they are all off the free list
+  u32 moved{0};
+  usize source{0};
+  usize target = count != 0 ? count - 1 : 0;
+  usize cursor{0};
+
+  try {
+    while (source < target and moved < budget and room >= order[source]->live) {
+      PageInfo& page = *order[source];
+      u8* const first = first_block(page.page);
+
+      for (usize i = 0; i < page.carved and moved < budget; i++) {
+        if ((page.in_use[i / 64] & (u64{1} << (i % 64))) == 0) {
+          continue;
+        }
+
+        u8* block = claim_free_block(*order[target], cursor);
+
+        // the room check guarantees a page before this source has one
+        while (block == nullptr) {
+          target--;
+          cursor = 0;
+          block = claim_free_block(*order[target], cursor);
+        }
+
+        moves[moved].from = first + i * block_size;
+        moves[moved].from_page = &page;
+        moves[moved].to = block;
+        room--;
+        moved++;
+      }
+
+      source++;
+
+      if (source < target) {
+        room -= order[source]->carved - order[source]->live;
+      }
+    }
+
+    // one walk of the free list however many blocks were claimed
+    if (moved != 0 and config.AllocationPolicy_ == OAConfig::apLifo) {
+      drop_in_use_free_blocks();
+    }
+
+    for (usize i = 0; i < moved; i++) {
+      const Move& move = moves[i];
+      const OAHandle old_handle = relocate ? HandleOf(move.from) : NULL_HANDLE;
+
+      move_block(*move.from_page, move.from, move.to);
+
+      if (relocate) {
+        relocate(move.from, move.to, old_handle, HandleOf(move.to), context);
+      }
+    }
+  } catch (...) {
+    delete[] moves;
+    delete[] order;
+    throw;
+  }
+
+  delete[] moves;
+  delete[] order;
+
+  if (moved != 0) {
+    FreeEmptyPages();
+  }
+
+  return moved;
+}
+
+u8* ObjectAllocator::claim_free_block(PageInfo& info, usize& cursor) {
+  u8* block{nullptr};
+
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    block = info.free_blocks;
+
+    if (block != nullptr) {
+      info.free_blocks = as_bytes(as_list(block).Next);
+    }
+  } else {
+    for (; cursor < info.carved and block == nullptr; cursor++) {
+      if ((info.in_use[cursor / 64] & (u64{1} << (cursor % 64))) == 0) {
+        block = first_block(info.page) + cursor * block_size;
+      }
+    }
+  }
+
+  if (block != nullptr) {
+    set_in_use(info, block, true);
+  }
+
+  return block;
+}
+
+void ObjectAllocator::move_block(PageInfo& from_info, u8* const from, u8* const to) {
+  u8* const from_header = from - config.PadBytes_ - config.HBlockInfo_.size_;
+  u8* const to_header = to - config.PadBytes_ - config.HBlockInfo_.size_;
+
+  memcpy(to, from, object_size);
+
+  // the object's allocation stays with its site, and its sample (if any) with it
+  if (config.Profile_) {
+    PageInfo& to_info = *owner_of(to);
+    to_info.sites[block_index(to_info, to)] = from_info.sites[block_index(from_info, from)];
+  }
+
+  if ((from_info.sample_filter & sample_filter_bit(from)) and heap_sample_blocks[sample_slot(from)] == from) {
+    const HeapSample moved = heap_samples[sample_slot(from)];
+    MemBlockInfoPool::RetainLabel(moved.label);
+    forget_sample(from_info, from);
+
+    HeapSample* const target = insert_sample(*owner_of(to), to);
+
+    if (target) {
+      *target = moved;
+    } else {
+      MemBlockInfoPool::ReleaseLabel(moved.label);
+    }
+  }
+
+  switch (config.HBlockInfo_.type_) {
+    case OAConfig::hbBasic: memcpy(to_header, from_header, config.HBlockInfo_.size_); break;
+    case OAConfig::hbExtended:
+      {
+        // the use counter belongs to the block (it is the generation of its handles), everything else moves
+        u16 uses;
+        memcpy(&uses, to_header + config.HBlockInfo_.additional_, sizeof(u16));
+        memcpy(to_header, from_header, config.HBlockInfo_.size_);
+        uses++;
+        memcpy(to_header + config.HBlockInfo_.additional_, &uses, sizeof(u16));
+        break;
+      }
+    case OAConfig::hbExternal:
+      {
+        // the label goes along with the object, the source is left with no info (free)
+        MemBlockInfo** const from_info_ptr = reinterpret_cast<MemBlockInfo**>(from_header);
+        *reinterpret_cast<MemBlockInfo**>(to_header) = *from_info_ptr;
+        *from_info_ptr = nullptr;
+        break;
+      }
+    case OAConfig::hbNone:
+    default: break;
+  }
+
+  set_in_use(from_info, from, false);
+
+  if (config.HBlockInfo_.type_ != OAConfig::hbExternal) {
+    setup_freed_header(from_header);
+  }
+
+  if (config.DebugOn_) {
+    memset(from, FREED_PATTERN, object_size);
   }
 
-  throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry, not on any pages");
+  push_free_block(from, &from_info);
 }
 
-u32 ObjectAllocator::DumpMemoryInUse(const DUMPCALLBACK callback) const {
-  u32 in_use{0};
+void ObjectAllocator::drop_in_use_free_blocks() {
+  GenericObject* prev = nullptr;
+  GenericObject* free = &as_list(free_list);
+  PageInfo* info{nullptr};
 
-  for (const GenericObject* page = &as_list(page_list); page; page = page->Next) {
-    const u8* first_block =
-      as_bytes(page) + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+  while (free) {
+    GenericObject* const next = free->Next;
+    const u8* const block = as_bytes(free);
 
-    for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-      const u8* block = first_block + i * block_size;
-      if (not is_in_free_list(block)) {
-        in_use++;
-        callback(block, object_size);
-      }
+    info = page_of(block, info);
+    const usize index = block_index(*info, block);
+
+    if ((info->in_use[index / 64] & (u64{1} << (index % 64))) == 0) {
+      prev = free;
+    } else if (prev) {
+      prev->Next = next;
+    } else {
+      free_list = as_bytes(next);
     }
-  }
 
-  return in_use;
+    free = next;
+  }
 }
 
-u32 ObjectAllocator::ValidatePages(const VALIDATECALLBACK callback) const {
-  if (not config.DebugOn_ or config.PadBytes_ == 0) {
-    return 0;
-  }
+usize ObjectAllocator::mark_pages_to_release() {
+  const u64 now = config.RetainEmptyPages_ != 0 ? idle_clock_ms() : 0;
+  usize retained{0};
 
-  const GenericObject* page = &as_list(page_list);
-  u32 invalid_count{0};
+  for (usize i = 0; i < page_count; i++) {
+    PageInfo& info = *page_directory[i];
 
-  while (page) {
-    const u8* first_block =
-      as_bytes(page) + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+    info.released = false;
 
-    for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-      const u8* const block = first_block + block_size * i;
-      if (not validate_block(block)) {
-        callback(block, object_size);
-        invalid_count++;
-      }
-    };
+    if (not is_page_empty(info)) {
+      info.empty_since = 0;
+      continue;
+    }
 
-    page = page->Next;
-  }
+    if (config.RetainEmptyPages_ == 0) {
+      info.released = true;
+      continue;
+    }
 
-  return invalid_count;
-}
+    if (info.empty_since == 0) {
+      info.empty_since = now;
+    }
 
-void ObjectAllocator::free_page(u8* const page) const {
-  // no invariants need to be preserved if there is no exernal header (heap-allocated)
-  if (config.HBlockInfo_.type_ != OAConfig::hbExternal) {
-    delete[] page;
-    return;
+    info.released = config.RetainIdleMs_ != 0 and now - info.empty_since >= config.RetainIdleMs_;
+
+    if (not info.released) {
+      retained++;
+    }
   }
 
-  u8* const first_header = page + sizeof(GenericObject) + config.LeftAlignSize_;
+  // over the limit, the pages that have been idle the longest go first (pages stamped by the same call tie)
+  while (retained > config.RetainEmptyPages_) {
+    u64 oldest = ~u64{0};
 
-  for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-    MemBlockInfo*& info = *reinterpret_cast<MemBlockInfo**>(first_header + i * block_size);
+    for (usize i = 0; i < page_count; i++) {
+      const PageInfo& info = *page_directory[i];
 
-    if (info == nullptr) {
-      continue;
+      if (info.empty_since != 0 and not info.released and info.empty_since < oldest) {
+        oldest = info.empty_since;
+      }
     }
 
-    if (info->label) {
-      delete[] info->label;
-    }
+    for (usize i = 0; i < page_count and retained > config.RetainEmptyPages_; i++) {
+      PageInfo& info = *page_directory[i];
 
-    delete info;
+      if (info.empty_since == oldest and not info.released) {
+        info.released = true;
+        retained--;
+      }
+    }
   }
 
-  delete[] page;
+  return retained;
 }
 
-u32 ObjectAllocator::FreeEmptyPages() {
-  u32 freed{0};
+void ObjectAllocator::release_marked_pages(const usize released_blocks) {
+  cull_free_blocks_in_released_pages(released_blocks);
 
   GenericObject* prev = nullptr;
   GenericObject* page = &as_list(page_list);
 
   while (page) {
 
-    if (not is_page_empty(as_bytes(page))) {
+    if (not owner_of(as_bytes(page))->released) {
       prev = page;
       page = page->Next;
       continue;
     }
 
-    freed++;
-
     GenericObject* next = page->Next;
-    cull_free_blocks_in_page(as_bytes(page));
     free_page(as_bytes(page));
     statistics.PagesInUse_--;
 
@@ -263,28 +2508,65 @@ u32 ObjectAllocator::FreeEmptyPages() {
     } else {
       page_list = as_bytes(page);
     }
+  }
 
-    continue;
+  // drop the released pages from the directory, keeping it sorted
+  usize kept{0};
+
+  for (usize i = 0; i < page_count; i++) {
+    if (not page_directory[i]->released) {
+      page_starts[kept] = page_starts[i];
+      page_directory[kept++] = page_directory[i];
+    } else {
+      page_table[page_directory[i]->id] = nullptr;
+      delete_page_info(page_directory[i]);
+    }
   }
 
-  return freed;
+  page_count = kept;
 }
 
-void ObjectAllocator::cull_free_blocks_in_page(const u8* const page) {
+void ObjectAllocator::cull_free_blocks_in_released_pages(usize count) {
+  // every free block of a released page is on that page's own list, which goes with it
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    for (usize i = 0; i < page_count; i++) {
+      PageInfo& info = *page_directory[i];
+
+      if (info.released) {
+        unlink_partial(info);
+        statistics.FreeObjects_ -= info.carved;
+      }
+    }
+
+    return;
+  }
+
+  // every carved block that is not live sits on the free list, so the pages alone tell whether any block stays
+  usize listed{0};
+
+  for (usize i = 0; i < page_count; i++) {
+    listed += page_directory[i]->carved - page_directory[i]->live;
+  }
+
+  if (listed == count) {
+    statistics.FreeObjects_ -= static_cast<unsigned>(count);
+    free_list = nullptr;
+    return;
+  }
 
+  // otherwise unlinking needs each block's predecessor, the walk stops at the last block of a released page
   GenericObject* prev = nullptr;
   GenericObject* free = &as_list(free_list);
 
-  while (free) {
-    const u8* bytes = as_bytes(free);
-
-    if (not(bytes > page and bytes < page + page_size)) {
+  while (free and count != 0) {
+    if (not owner_of(as_bytes(free))->released) {
       prev = free;
       free = free->Next;
       continue;
     }
 
     statistics.FreeObjects_--;
+    count--;
 
     GenericObject* next = free->Next;
     free = next;
@@ -299,28 +2581,37 @@ void ObjectAllocator::cull_free_blocks_in_page(const u8* const page) {
   }
 }
 
-bool ObjectAllocator::is_page_empty(u8* page) const {
-  const u8* first_block =
-    page + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+bool ObjectAllocator::is_page_empty(const PageInfo& info) { return info.live == 0; }
 
-  for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-    const u8* block = first_block + i * block_size;
-    if (not is_in_free_list(block)) {
-      return false;
-    }
+void ObjectAllocator::SetDebugState(const bool State) { config.DebugOn_ = State; }
+
+const void* ObjectAllocator::GetFreeList() const {
+  if (config.ConcurrentFreeList_) {
+    return untag_pointer(concurrent_free_list.load(std::memory_order_acquire));
   }
-  return true;
-}
 
-void ObjectAllocator::SetDebugState(const bool State) { config.DebugOn_ = State; }
+  // the list Allocate takes from next
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    const PageInfo* const info = fullest_partial_page();
+    return info ? info->free_blocks : nullptr;
+  }
 
-const void* ObjectAllocator::GetFreeList() const { return free_list; }
+  return free_list;
+}
 
 const void* ObjectAllocator::GetPageList() const { return page_list; }
 
 const OAConfig& ObjectAllocator::GetConfig() const { return config; }
 
-const OAStats& ObjectAllocator::GetStats() const { return statistics; }
+const OAStats& ObjectAllocator::GetStats() const {
+  if (config.ConcurrentFreeList_) {
+    std::lock_guard<std::mutex> guard{page_lock};
+    snapshot_concurrent_stats();
+    return concurrent_stats;
+  }
+
+  return statistics;
+}
 
 bool ObjectAllocator::ImplementedExtraCredit() { return true; }
 
@@ -338,75 +2629,114 @@ void ObjectAllocator::allocate_page() {
     throw OAException(OAException::E_NO_PAGES, "Out of pages");
   }
 
+  reserve_page_directory();
+
+  PageInfo* info{nullptr};
   u8* memory;
 
   try {
-    memory = new u8[page_size]{};
+    info = new PageInfo{nullptr, nullptr, 0, 0, 0, false, nullptr, nullptr, nullptr, 0, 0, nullptr, 0, 0};
+    info->in_use = new u64[bitmap_words()]{};
+
+    if (config.Profile_) {
+      info->sites = new u32[config.ObjectsPerPage_]{};
+    }
   } catch (const std::bad_alloc& err) {
+    if (info) {
+      delete[] info->in_use;
+    }
+
+    delete info;
     throw OAException(OAException::E_NO_MEMORY, err.what());
   }
 
+  try {
+    memory = map_page();
+  } catch (const OAException&) {
+    delete_page_info(info);
+    throw;
+  }
+
+  info->page = memory;
+
   // up the stat, was added to the list
   statistics.PagesInUse_++;
 
   as_list(memory).Next = &as_list(page_list);
   page_list = memory;
+  register_page(info);
 
   // signing
   //
-  if (config.DebugOn_) {
-    memset(page_list + sizeof(GenericObject), ALIGN_PATTERN, config.LeftAlignSize_);
-  }
-
-  u8* const first_obj =
-    page_list + sizeof(GenericObject) + config.HBlockInfo_.size_ + config.LeftAlignSize_ + config.PadBytes_;
+  memset(page_list + sizeof(GenericObject), config.DebugOn_ ? ALIGN_PATTERN : 0, config.LeftAlignSize_);
 
-  for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-    u8* block = first_obj + block_size * i - config.PadBytes_;
+  statistics.FreeObjects_ += config.ObjectsPerPage_;
 
-    // skipover header
-    memset(block, PAD_PATTERN, config.PadBytes_);
-    block += config.PadBytes_;
+  // blocks are signed (and headers initialised) one at a time as the bump pointer reaches them
+  if (config.LazyPageInit_) {
+    bump_page = info;
+    return;
+  }
 
-    memset(block, UNALLOCATED_PATTERN, object_size);
-    block += object_size;
+  info->carved = config.ObjectsPerPage_;
 
-    memset(block, PAD_PATTERN, config.PadBytes_);
+  // heap pages are not zeroed by map_page (lazy pages never read what they have not carved), signing relies on it
+  if (config.PageBackend_ == OAConfig::pbHeap) {
+    const usize signed_offset = sizeof(GenericObject) + config.LeftAlignSize_;
+    memset(page_list + signed_offset, 0, page_size - signed_offset);
   }
 
-  for (usize i = 1; i < config.ObjectsPerPage_; i++) {
-    u8* const block = first_obj + block_size * i;
-    u8* const prev_block = first_obj + block_size * (i - 1);
+  u8* const first_obj =
+    page_list + sizeof(GenericObject) + config.HBlockInfo_.size_ + config.LeftAlignSize_ + config.PadBytes_;
 
-    if (config.DebugOn_) {
-      memset(prev_block + object_size + config.PadBytes_, ALIGN_PATTERN, config.InterAlignSize_);
-    }
+  sign_page_blocks(first_obj - config.PadBytes_ - config.HBlockInfo_.size_);
+
+  for (usize i = 1; i < config.ObjectsPerPage_; i++) {
+    as_list(first_obj + block_size * i).Next = &as_list(first_obj + block_size * (i - 1));
+  }
 
-    as_list(block).Next = &as_list(prev_block);
+  if (config.ConcurrentFreeList_) {
+    // publish the whole page with one CAS, the caller holds the page lock
+    push_concurrent(first_obj + block_size * (config.ObjectsPerPage_ - 1), first_obj);
+    snapshot_concurrent_stats();
+    return;
   }
 
-  // initialise header blocks
-  init_header_blocks_for_page(first_obj - config.PadBytes_ - config.HBlockInfo_.size_);
+  if (config.AllocationPolicy_ == OAConfig::apFullestPage) {
+    as_list(first_obj).Next = nullptr;
+    info->free_blocks = first_obj + block_size * (config.ObjectsPerPage_ - 1);
+    rebucket(*info);
+    return;
+  }
 
   as_list(first_obj).Next = &as_list(free_list);
   free_list = first_obj + block_size * (config.ObjectsPerPage_ - 1);
-
-  statistics.FreeObjects_ += config.ObjectsPerPage_;
 }
 
-void ObjectAllocator::init_header_blocks_for_page(u8* const first_header) const {
-  if (config.HBlockInfo_.size_ == 0) {
-    return;
-  }
-  // memcpy the default header to each one to skip multiple branches
-  for (usize i = 0; i < config.ObjectsPerPage_; i++) {
-    memset(first_header + i * block_size, 0, config.HBlockInfo_.size_);
+void ObjectAllocator::sign_page_blocks(u8* const first_header) const {
+  // the inter alignment bytes are only signed in debug mode, otherwise they keep the page's zeroes
+  const usize signed_size = config.DebugOn_ ? block_size : block_size - config.InterAlignSize_;
+
+  for (usize i = 0; i + 1 < config.ObjectsPerPage_; i++) {
+    memcpy(first_header + i * block_size, block_image, signed_size);
   }
+
+  // the last block has no inter alignment, the page ends after its right pad (CacheLineLayout_ pads it with zeroes)
+  memcpy(first_header + (config.ObjectsPerPage_ - 1) * block_size, block_image, block_size - config.InterAlignSize_);
 }
 
 bool ObjectAllocator::is_in_free_list(const u8* const block) const {
   const u8* header = block - config.PadBytes_ - config.HBlockInfo_.size_;
 
+  // blocks past the bump pointer are free, their headers were never written
+  if (config.LazyPageInit_) {
+    const PageInfo* const info = owner_of(block);
+
+    if (block_index(*info, block) >= info->carved) {
+      return true;
+    }
+  }
+
   switch (config.HBlockInfo_.type_) {
     case OAConfig::hbBasic:
       {
@@ -428,15 +2758,10 @@ bool ObjectAllocator::is_in_free_list(const u8* const block) const {
     default: break;
   }
 
-  const GenericObject* free = &as_list(free_list);
-
-  for (; free; free = free->Next) {
-    if (free == &as_list(block)) {
-      return true;
-    }
-  }
+  const PageInfo* const info = owner_of(block);
+  const usize index = block_index(*info, block);
 
-  return false;
+  return (info->in_use[index / 64] & (u64{1} << (index % 64))) == 0;
 }
 
 bool ObjectAllocator::validate_page(const u8* const page) const {
@@ -444,8 +2769,10 @@ bool ObjectAllocator::validate_page(const u8* const page) const {
 
   const u8* first_block =
     page + sizeof(GenericObject) + config.LeftAlignSize_ + config.HBlockInfo_.size_ + config.PadBytes_;
+  const usize carved = owner_of(page)->carved;
 
-  for (usize i = 0; i < config.ObjectsPerPage_ - 1; i++) {
+  // blocks past the bump pointer have not been signed yet
+  for (usize i = 0; i < config.ObjectsPerPage_ - 1 and i < carved; i++) {
     const u8* const block = first_block + block_size * i;
     if (not validate_block(block)) {
       return false;
@@ -469,7 +2796,7 @@ bool ObjectAllocator::validate_block(const u8* block) const {
   return true;
 }
 
-void ObjectAllocator::setup_allocated_header(u8* const header, const char* label) const {
+void ObjectAllocator::setup_allocated_header(u8* const header, const char* label, const u32 alloc_num) {
   if (config.HBlockInfo_.size_ == 0) {
     return;
   }
@@ -478,7 +2805,7 @@ void ObjectAllocator::setup_allocated_header(u8* const header, const char* label
     case OAConfig::hbBasic:
       {
         // set allocation number ID
-        *reinterpret_cast<u32*>(header) = statistics.Allocations_;
+        *reinterpret_cast<u32*>(header) = alloc_num;
 
         // set in use flag to on
         *(header + sizeof(u32)) |= 0x1;
@@ -496,7 +2823,7 @@ void ObjectAllocator::setup_allocated_header(u8* const header, const char* label
         (*reinterpret_cast<u16*>(pos))++;
         pos += sizeof(u16);
 
-        *reinterpret_cast<u32*>(pos) = statistics.Allocations_;
+        *reinterpret_cast<u32*>(pos) = alloc_num;
         pos += sizeof(u32);
 
         // set in use flag to on
@@ -505,15 +2832,10 @@ void ObjectAllocator::setup_allocated_header(u8* const header, const char* label
       }
     case OAConfig::hbExternal:
       {
+        // no heap call once the label has been seen and the pool has grown to the peak in use
+        const std::unique_lock<std::mutex> guard = external_guard();
 
-        char* label_copy = nullptr;
-
-        if (label != nullptr) {
-          label_copy = new char[strlen(label) + 1]{};
-          strcpy(label_copy, label);
-        }
-
-        *reinterpret_cast<MemBlockInfo**>(header) = new MemBlockInfo{true, label_copy, statistics.Allocations_};
+        *reinterpret_cast<MemBlockInfo**>(header) = block_infos.Acquire(label, alloc_num);
 
         return;
       }
@@ -522,7 +2844,7 @@ void ObjectAllocator::setup_allocated_header(u8* const header, const char* label
   }
 }
 
-void ObjectAllocator::setup_freed_header(u8* header) const {
+void ObjectAllocator::setup_freed_header(u8* header) {
   if (config.HBlockInfo_.size_ == 0) {
     return;
   }
@@ -555,14 +2877,9 @@ void ObjectAllocator::setup_freed_header(u8* header) const {
     case OAConfig::hbExternal:
       {
         MemBlockInfo** const info = reinterpret_cast<MemBlockInfo**>(header);
+        const std::unique_lock<std::mutex> guard = external_guard();
 
-        // delete the label
-        if ((*info)->label) {
-          delete[] (*info)->label;
-        }
-
-        // delete the external data
-        delete *info;
+        block_infos.Release(*info);
 
         *info = nullptr;
 
@@ -573,15 +2890,256 @@ void ObjectAllocator::setup_freed_header(u8* header) const {
   }
 }
 
-bool ObjectAllocator::is_signed_as(const u8* ptr, const usize extents, const u8 pattern) {
+MemBlockInfoPool::MemBlockInfoPool(const usize chunk_records) noexcept:
+    chunk_records{chunk_records != 0 ? chunk_records : 1} {}
 
-  for (usize i = 0; i < extents; i++) {
-    if (ptr[i] != pattern) {
-      return false;
+MemBlockInfoPool::~MemBlockInfoPool() noexcept {
+  for (usize i = 0; i < label_table_size; i++) {
+    if (labels[i] != nullptr) {
+      delete[] (&holds(labels[i]));
     }
   }
 
-  return true;
+  delete[] labels;
+
+  while (chunks) {
+    Slot* const chunk = chunks;
+    chunks = chunk->next;
+    delete[] chunk;
+  }
+}
+
+MemBlockInfo* MemBlockInfoPool::Acquire(const char* const label, const u32 alloc_num) {
+  const char* const interned = InternLabel(label);
+
+  if (free_slots == nullptr) {
+    Slot* chunk{nullptr};
+
+    try {
+      chunk = new Slot[chunk_records + 1];
+    } catch (const std::bad_alloc& err) {
+      ReleaseLabel(interned);
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+
+    chunk[0].next = chunks;
+    chunks = chunk;
+    chunk_count++;
+
+    // pushed last to first so records are handed out in address order
+    for (usize i = chunk_records; i != 0; i--) {
+      chunk[i].next = free_slots;
+      free_slots = &chunk[i];
+    }
+  }
+
+  Slot* const slot = free_slots;
+  free_slots = slot->next;
+  slot->info = MemBlockInfo{true, interned, alloc_num};
+
+  return &slot->info;
+}
+
+void MemBlockInfoPool::Release(MemBlockInfo* const info) noexcept {
+  // the label stays interned for the next block allocated with it
+  ReleaseLabel(info->label);
+
+  Slot* const slot = reinterpret_cast<Slot*>(info);
+  slot->next = free_slots;
+  free_slots = slot;
+}
+
+const char* MemBlockInfoPool::InternLabel(const char* const label) {
+  if (label == nullptr) {
+    return nullptr;
+  }
+
+  const usize hash = label_hash(label);
+
+  if (label_table_size != 0) {
+    for (usize slot = hash & (label_table_size - 1); labels[slot] != nullptr; slot = (slot + 1) & (label_table_size - 1)) {
+      if (strcmp(labels[slot], label) == 0) {
+        holds(labels[slot])++;
+        return labels[slot];
+      }
+    }
+  }
+
+  try {
+    // kept at most half full so probes stay short, the labels nothing holds make room before the table grows
+    if ((label_count + 1) * 2 > label_table_size) {
+      const usize held = held_labels();
+      rebuild_labels(held, held + 1);
+    }
+
+    // the hold count goes in the word before the characters
+    const usize length = strlen(label);
+    usize* const storage = new usize[1 + (length + sizeof(usize)) / sizeof(usize)];
+    char* const copy = reinterpret_cast<char*>(storage + 1);
+
+    storage[0] = 1;
+    memcpy(copy, label, length + 1);
+
+    usize slot = hash & (label_table_size - 1);
+
+    while (labels[slot] != nullptr) {
+      slot = (slot + 1) & (label_table_size - 1);
+    }
+
+    labels[slot] = copy;
+    label_count++;
+
+    return copy;
+  } catch (const std::bad_alloc& err) {
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+}
+
+void MemBlockInfoPool::RetainLabel(const char* const label) noexcept {
+  if (label != nullptr) {
+    holds(label)++;
+  }
+}
+
+void MemBlockInfoPool::ReleaseLabel(const char* const label) noexcept {
+  if (label != nullptr) {
+    holds(label)--;
+  }
+}
+
+void MemBlockInfoPool::Trim() noexcept {
+  // running out of memory only means keeping what there is
+  try {
+    const usize held = held_labels();
+
+    if (held != label_count) {
+      rebuild_labels(held, held);
+    }
+
+    trim_chunks();
+  } catch (const std::bad_alloc&) {
+  }
+}
+
+usize& MemBlockInfoPool::holds(const char* const label) {
+  return *(reinterpret_cast<usize*>(const_cast<char*>(label)) - 1);
+}
+
+usize MemBlockInfoPool::held_labels() const {
+  usize held{0};
+
+  for (usize i = 0; i < label_table_size; i++) {
+    held += labels[i] != nullptr and holds(labels[i]) != 0;
+  }
+
+  return held;
+}
+
+void MemBlockInfoPool::rebuild_labels(const usize held, const usize room) {
+  usize size{room != 0 ? 16u : 0u};
+
+  while (room * 2 > size) {
+    size *= 2;
+  }
+
+  char** const table = size != 0 ? new char*[size]{} : nullptr;
+
+  for (usize i = 0; i < label_table_size; i++) {
+    if (labels[i] == nullptr) {
+      continue;
+    }
+
+    if (holds(labels[i]) == 0) {
+      delete[] (&holds(labels[i]));
+      continue;
+    }
+
+    usize slot = label_hash(labels[i]) & (size - 1);
+
+    while (table[slot] != nullptr) {
+      slot = (slot + 1) & (size - 1);
+    }
+
+    table[slot] = labels[i];
+  }
+
+  delete[] labels;
+  labels = table;
+  label_table_size = size;
+  label_count = held;
+}
+
+void MemBlockInfoPool::trim_chunks() {
+  if (chunk_count == 0) {
+    return;
+  }
+
+  // free records counted per chunk, chunks sorted by address so a record's chunk is a binary search away
+  Slot** const starts = new Slot*[chunk_count];
+  usize* free_counts{nullptr};
+
+  try {
+    free_counts = new usize[chunk_count]{};
+  } catch (...) {
+    delete[] starts;
+    throw;
+  }
+
+  usize n{0};
+
+  for (Slot* chunk = chunks; chunk; chunk = chunk->next) {
+    starts[n++] = chunk;
+  }
+
+  std::sort(starts, starts + n);
+
+  const auto chunk_of = [&](const Slot* const slot) {
+    return static_cast<usize>(std::upper_bound(starts, starts + n, slot) - starts) - 1;
+  };
+
+  for (const Slot* slot = free_slots; slot; slot = slot->next) {
+    free_counts[chunk_of(slot)]++;
+  }
+
+  // records of the chunks kept stay in the order they were freed
+  Slot** tail = &free_slots;
+
+  for (Slot* slot = free_slots; slot; slot = slot->next) {
+    if (free_counts[chunk_of(slot)] != chunk_records) {
+      *tail = slot;
+      tail = &slot->next;
+    }
+  }
+
+  *tail = nullptr;
+  chunks = nullptr;
+  chunk_count = 0;
+
+  for (usize i = 0; i < n; i++) {
+    if (free_counts[i] == chunk_records) {
+      delete[] starts[i];
+      continue;
+    }
+
+    starts[i]->next = chunks;
+    chunks = starts[i];
+    chunk_count++;
+  }
+
+  delete[] free_counts;
+  delete[] starts;
+}
+
+std::unique_lock<std::mutex> ObjectAllocator::external_guard() {
+  return config.ConcurrentFreeList_ ? std::unique_lock<std::mutex>{external_lock} : std::unique_lock<std::mutex>{};
+}
+
+bool ObjectAllocator::is_signed_as(const u8* ptr, const usize extents, const u8 pattern) {
+  if (extents >= SIMD_PATTERN_THRESHOLD) {
+    return pattern_kernel(ptr, extents, pattern);
+  }
+
+  return is_signed_as_scalar(ptr, extents, pattern);
 }
 
 // NOLINTEND(*-exception-baseclass)
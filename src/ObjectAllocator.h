@@ -1,9 +1,12 @@
 #ifndef OBJECTALLOCATORH
 #define OBJECTALLOCATORH
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <string>
+#include <thread>
 
 // If the client doesn't specify these:
 static constexpr int DEFAULT_OBJECTS_PER_PAGE = 4;
@@ -56,6 +59,21 @@ using usize = std::size_t;
  */
 using uptr = std::uintptr_t;
 
+/**
+ * @brief 32 bit reference to an object: {page, slot, generation}, 0 is the null handle
+ */
+using OAHandle = std::uint32_t;
+
+/**
+ * @brief Handle that never refers to an object
+ */
+static constexpr OAHandle NULL_HANDLE = 0;
+
+/**
+ * @brief Bytes in a cache line, what OAConfig::CacheLineLayout_ pads blocks out to
+ */
+static constexpr usize CACHE_LINE_SIZE = 64;
+
 /**
  * @brief Signed 8 bit Integer
  */
@@ -147,6 +165,31 @@ struct OAConfig final {
     hbExternal
   };
 
+  /**
+   * Where the memory for pages comes from
+   */
+  enum PAGE_BACKEND {
+    pbHeap,  //!< new u8[], arbitrary alignment
+    pbMapped //!< mmap, every page naturally aligned on a power of two (its span) so its owner is found by masking
+  };
+
+  /**
+   * Huge page hint for pbMapped pages
+   */
+  enum HUGE_PAGES {
+    hpNone,
+    hpAdvise, //!< madvise(MADV_HUGEPAGE), transparent huge pages if the kernel has them
+    hpHugeTLB //!< MAP_HUGETLB, spans are rounded up to the huge page size (falls back to hpAdvise if none reserved)
+  };
+
+  /**
+   * Which free block Allocate hands out
+   */
+  enum ALLOCATION_POLICY {
+    apLifo,       //!< the most recently freed one, from the single free list
+    apFullestPage //!< one from the most occupied page that still has a free block, so sparse pages drain and empty
+  };
+
   /**
    * POD that stores the information related to the header blocks.
    */
@@ -210,6 +253,17 @@ struct OAConfig final {
     HBlockInfo_ = HBInfo;
     LeftAlignSize_ = 0;
     InterAlignSize_ = 0;
+    ConcurrentFreeList_ = false;
+    PageBackend_ = pbHeap;
+    HugePages_ = hpNone;
+    LazyPageInit_ = false;
+    RetainEmptyPages_ = 0;
+    RetainIdleMs_ = 0;
+    RemoteFree_ = false;
+    CacheLineLayout_ = false;
+    AllocationPolicy_ = apLifo;
+    Profile_ = false;
+    SampleInterval_ = 0;
   }
 
   bool UseCPPMemManager_;      //!< by-pass the functionality of the OA and use new/delete
@@ -221,6 +275,17 @@ struct OAConfig final {
   unsigned Alignment_;         //!< address alignment of each block
   unsigned LeftAlignSize_;     //!< number of alignment bytes required to align first block
   unsigned InterAlignSize_;    //!< number of alignment bytes required between remaining blocks
+  bool ConcurrentFreeList_;    //!< lock-free free list, Allocate/Free may be called from many threads at once
+  PAGE_BACKEND PageBackend_;   //!< where page memory comes from
+  HUGE_PAGES HugePages_;       //!< huge page hint when PageBackend_ is pbMapped
+  bool LazyPageInit_;          //!< carve new pages with a bump pointer instead of signing/threading them up front
+  unsigned RetainEmptyPages_;  //!< empty pages FreeEmptyPages keeps (signed, blocks on the free list) for reuse
+  unsigned RetainIdleMs_;      //!< a retained page still empty after this long is released anyway (0=no limit)
+  bool RemoteFree_;            //!< threads other than the owner Free onto a lock-free queue the owner drains
+  bool CacheLineLayout_;       //!< objects start on a cache line and blocks fill whole lines, no two objects share one
+  ALLOCATION_POLICY AllocationPolicy_; //!< which free block Allocate hands out (apFullestPage keeps a list per page)
+  bool Profile_;               //!< keep running totals per label and call site (see ObjectAllocator::GetProfile)
+  unsigned SampleInterval_;    //!< record the stack of one in this many allocations on average (0=no sampling)
 };
 
 /**
@@ -238,7 +303,8 @@ struct OAStats final {
       PagesInUse_(0),
       MostObjects_(0),
       Allocations_(0),
-      Deallocations_(0) {};
+      Deallocations_(0),
+      RetainedPages_(0) {};
 
   usize ObjectSize_;       //!< size of each object
   usize PageSize_;         //!< size of a page including all headers, padding, etc.
@@ -248,6 +314,20 @@ struct OAStats final {
   unsigned MostObjects_;   //!< most objects in use by client at one time
   unsigned Allocations_;   //!< total requests to allocate memory
   unsigned Deallocations_; //!< total requests to free memory
+  unsigned RetainedPages_; //!< empty pages kept by FreeEmptyPages instead of being released
+};
+
+/**
+ * One row of an allocation profile, see ObjectAllocator::GetProfile
+ */
+struct OAProfileEntry final {
+  const char* label;              //!< Label given to Allocate (nullptr if none), owned by the allocator
+  const void* caller;             //!< Return address of the Allocate call (nullptr when grouped by label)
+  u64 allocations;                //!< Objects allocated so far
+  u64 deallocations;              //!< Objects freed so far
+  u64 live_objects;               //!< Objects still in use
+  u64 live_bytes;                 //!< Bytes still in use (live objects times the object size)
+  double allocations_per_second;  //!< Allocations over the time since the allocator was created
 };
 
 /**
@@ -264,10 +344,142 @@ static_assert(sizeof(GenericObject) == sizeof(void*), "GenericObject has non tra
  */
 struct MemBlockInfo {
   bool in_use;   //!< Is the block free or in use?
-  char* label;   //!< A dynamically allocated NUL-terminated string
+  const char* label; //!< An interned NUL-terminated string, owned by the allocator (nullptr if none)
   u32 alloc_num; //!< The allocation number (count) of this block
 };
 
+/**
+ * Interned labels and pooled MemBlockInfo records, what external headers point to (ObjectAllocator and
+ * TypedObjectAllocator)
+ *
+ * A label is copied the first time its contents are seen, and counts the records, profile sites and heap samples
+ * holding it. Labels nothing holds are kept so they can be handed out again, until Trim or until the table would have
+ * to grow. Records come a chunk at a time and are reused, so no block needs a heap call once its label has been seen
+ * and the pool has grown to the peak in use. Not thread safe, the owner locks around it.
+ */
+class MemBlockInfoPool final {
+public:
+
+  /**
+   * @brief An empty pool, records are added chunk_records at a time
+   */
+  explicit MemBlockInfoPool(usize chunk_records) noexcept;
+
+  /**
+   * @brief Frees every label and record (never throws)
+   */
+  ~MemBlockInfoPool() noexcept;
+
+  /**
+   * @brief A record of a block in use, holding the interned label (nullptr stays nullptr)
+   *
+   * Throws an exception if the label or a chunk of records can't be allocated. (E_NO_MEMORY)
+   */
+  MemBlockInfo* Acquire(const char* label, u32 alloc_num);
+
+  /**
+   * @brief Returns a record to the pool along with its hold on its label
+   */
+  void Release(MemBlockInfo* info) noexcept;
+
+  /**
+   * @brief The interned copy of a label, held once more (nullptr stays nullptr)
+   *
+   * Throws an exception if the label can't be copied. (E_NO_MEMORY)
+   */
+  const char* InternLabel(const char* label);
+
+  /**
+   * @brief Holds an interned label once more (nullptr is ignored)
+   */
+  static void RetainLabel(const char* label) noexcept;
+
+  /**
+   * @brief Drops a hold on an interned label (nullptr is ignored)
+   */
+  static void ReleaseLabel(const char* label) noexcept;
+
+  /**
+   * @brief Frees the labels nothing holds and the chunks with no record in use
+   */
+  void Trim() noexcept;
+
+  /**
+   * @brief Labels interned, held or not
+   */
+  usize LabelCount() const { return label_count; }
+
+  // Prevent copy construction and assignment
+
+  MemBlockInfoPool(const MemBlockInfoPool&) = delete;            //!< Do not implement!
+  MemBlockInfoPool& operator=(const MemBlockInfoPool&) = delete; //!< Do not implement!
+
+private:
+
+  /**
+   * @brief A pooled record, linked through next while free
+   */
+  union Slot {
+    MemBlockInfo info; //!< The record while a block uses it
+    Slot* next;        //!< Next free record (or previous chunk, in the first slot of a chunk)
+  };
+
+  /**
+   * @brief How many times a label is held, stored in the word before its characters
+   */
+  static usize& holds(const char* label);
+
+  /**
+   * @brief Labels held at least once
+   */
+  usize held_labels() const;
+
+  /**
+   * @brief Moves the held labels to a table sized for room labels (none when room is 0) and frees the others
+   */
+  void rebuild_labels(usize held, usize room);
+
+  /**
+   * @brief Frees the chunks whose records are all free
+   */
+  void trim_chunks();
+
+  /**
+   * @brief Records a chunk adds
+   */
+  const usize chunk_records;
+
+  /**
+   * @brief Interned labels, open addressed by contents (linear probing), a power of two in size
+   */
+  char** labels{nullptr};
+
+  /**
+   * @brief Slots in labels
+   */
+  usize label_table_size{0};
+
+  /**
+   * @brief Labels interned
+   */
+  usize label_count{0};
+
+  /**
+   * @brief Free records
+   */
+  Slot* free_slots{nullptr};
+
+  /**
+   * @brief Last chunk of records, each chunk's first slot links to the one before
+   */
+  Slot* chunks{nullptr};
+
+  /**
+   * @brief Chunks allocated
+   */
+  usize chunk_count{0};
+};
+
 /**
  * This class represents a custom memory manager
  */
@@ -284,6 +496,19 @@ public:
    */
   using VALIDATECALLBACK = void (*)(const void*, usize);
 
+  /**
+   * @brief How GetProfile groups allocations
+   */
+  enum PROFILE_GROUPING {
+    pgLabel,   //!< one row per label (by contents, every call site merged)
+    pgCallSite //!< one row per label and return address of the Allocate call
+  };
+
+  /**
+   * @brief Callback function when Compact moves an object: old and new address, old and new handle, client context
+   */
+  using RELOCATECALLBACK = void (*)(void*, void*, OAHandle, OAHandle, void*);
+
   // Predefined values for memory signatures
 
   static constexpr u8 UNALLOCATED_PATTERN = 0xAA; //!< New memory never given to the client
@@ -292,6 +517,8 @@ public:
   static constexpr u8 PAD_PATTERN = 0xDD;         //!< Pad signature to detect buffer over/under flow
   static constexpr u8 ALIGN_PATTERN = 0xEE;       //!< For the alignment bytes
 
+  static constexpr usize FREE_BATCH_CHUNK = 256; //!< Number of objects FreeBatch sorts and validates at a time
+
   /*
    * Creates the ObjectManager per the specified values
    *
@@ -308,6 +535,10 @@ public:
    * Take an object from the free list and give it to the client (simulates new)
    *
    * Throws an exception if the object can't be allocated. (Memory allocation problem)
+   *
+   * With ConcurrentFreeList_ this (and Free) may be called from many threads at once. Everything else
+   * (DumpMemoryInUse, ValidatePages, FreeEmptyPages, ...) expects no Allocate/Free to be running at the same time.
+   * Debug checks then take the page lock, and double frees can only be detected with header blocks.
    */
   void* Allocate(const char* label = 0);
 
@@ -315,9 +546,47 @@ public:
    * Returns an object to the free list for the client (simulates delete)
    *
    * Throws an exception if the the object can't be freed. (Invalid object)
+   *
+   * With RemoteFree_, any thread but the owner pushes the block onto the remote free queue instead (lock-free, no
+   * checks, never throws) and the owner frees it for real on its next drain.
    */
   void Free(void* block_void_ptr);
 
+  /*
+   * Allocates n objects at once (same as n calls to Allocate, but bookkeeping is done once per batch)
+   *
+   * Throws an exception if the objects can't be allocated, in which case none of them are handed out.
+   * With ConcurrentFreeList_ blocks are still popped one by one (a shared chain can't be walked safely).
+   */
+  void AllocateBatch(void** out, usize n, const char* label = 0);
+
+  /*
+   * Returns n objects at once, grouped by page (sorted by address) before being pushed as one chain
+   *
+   * Throws an exception if an object can't be freed, objects are validated (and freed) in chunks of
+   * FREE_BATCH_CHUNK so the chunks before the offending one will have been freed.
+   */
+  void FreeBatch(void* const* in, usize n);
+
+  /*
+   * Frees every block other threads have queued with RemoteFree_, owning thread only
+   *
+   * Allocate does this by itself once the free list runs dry (before growing a page), and so does FreeEmptyPages.
+   * Until then queued blocks are still in use as far as the statistics are concerned, and their debug checks happen
+   * here: the first exception is rethrown once the rest of the queue is drained (a double free stops the drain, the
+   * queue can't be trusted past it).
+   *
+   * returns the number of blocks drained
+   */
+  u32 DrainRemoteFrees();
+
+  /*
+   * Makes the calling thread the owner (with RemoteFree_ only the owner touches the free list and pages)
+   *
+   * The thread that created the allocator owns it until then. Must not race with Allocate/Free.
+   */
+  void SetOwnerThread();
+
   /*
    * Calls the callback fn for each block still in use
    */
@@ -333,6 +602,180 @@ public:
    */
   u32 FreeEmptyPages();
 
+  /*
+   * Fills out with up to capacity rows of the allocation profile (Profile_), most live bytes first
+   *
+   * Totals are kept up to date by Allocate / Free (and their batch versions), nothing is walked here but the call
+   * sites. The call site is the return address of Allocate, AllocateBatch or AllocateHandle, so allocations made
+   * through a front end (ThreadCachedAllocator, SizeClassAllocator, ...) are attributed to the front end. Not
+   * available with UseCPPMemManager_ or ConcurrentFreeList_ (Profile_ is turned off).
+   *
+   * returns the number of rows in the profile, which can be more than capacity
+   */
+  usize GetProfile(OAProfileEntry* out, usize capacity, PROFILE_GROUPING grouping = pgLabel) const;
+
+  /*
+   * Returns the whole profile formatted as a table, one row per line (most live bytes first)
+   */
+  std::string ProfileReport(PROFILE_GROUPING grouping = pgLabel) const;
+
+  /*
+   * Writes the sampled blocks still in use (SampleInterval_) as a pprof heap profile (uncompressed protobuf)
+   *
+   * About one in SampleInterval_ allocations is sampled (the gaps are geometrically distributed, so allocation
+   * patterns can't line up with the sampling), its stack is captured and kept in a side table keyed by the block's
+   * address until it is freed. Each sample stands for SampleInterval_ objects in the inuse_objects / inuse_space
+   * values, and carries its label. Executable mappings are read from /proc/self/maps (Linux) so that pprof can
+   * symbolize the addresses against the binaries, e.g. go tool pprof -top <binary> <path>.
+   *
+   * returns false if the file can't be written
+   */
+  bool WriteHeapProfile(const char* path) const;
+
+  /*
+   * Returns the number of sampled blocks still in use
+   */
+  usize SampledObjects() const;
+
+  /*
+   * Returns the number of labels interned (FreeEmptyPages drops the ones no block, site or sample holds)
+   */
+  usize InternedLabels() const;
+
+  /**
+   * @brief Deepest stack captured for a sampled block
+   */
+  static constexpr u32 HEAP_SAMPLE_DEPTH = 32;
+
+  /*
+   * Moves up to budget objects out of the sparsest pages into the free blocks of the densest ones, then frees the
+   * pages that were emptied (FreeEmptyPages, so the retain policy still applies)
+   *
+   * A page is only evacuated if the denser pages have room for all of its objects, so repeated calls converge to
+   * as few pages as the objects in use fit in. Blocks a page has not carved yet (LazyPageInit_) are not used as room.
+   * Objects are copied as is (headers and labels go along, the hbExtended use counter stays with the block), and
+   * relocate is called for each one once it has moved: both its addresses and handles change, the client has to
+   * update every pointer or handle to it. Does nothing with UseCPPMemManager_ or ConcurrentFreeList_.
+   *
+   * Like FreeEmptyPages, no Allocate/Free may be running at the same time.
+   *
+   * returns the number of objects moved, 0 once there is nothing left to compact
+   */
+  u32 Compact(u32 budget, RELOCATECALLBACK relocate = nullptr, void* context = nullptr);
+
+  /*
+   * Allocates an object (like Allocate) and returns a handle to it instead of its address
+   *
+   * A handle packs the page's id, the block's slot on it and, with hbExtended headers, the low HANDLE_GENERATION_BITS
+   * of the block's use counter as its generation. Handles are not available with UseCPPMemManager_ or
+   * ConcurrentFreeList_ (no pages / no in use bitmap), or once there are more pages than a handle can number.
+   *
+   * Throws an exception if the object can't be allocated or handed out as a handle. (E_NO_PAGES for the latter)
+   */
+  OAHandle AllocateHandle(const char* label = 0);
+
+  /*
+   * Frees the object a handle refers to
+   *
+   * Throws E_BAD_BOUNDARY if the handle names no block, E_MULTIPLE_FREE if it is stale (the block was freed, and
+   * maybe handed out again since), plus whatever Free throws.
+   */
+  void FreeHandle(OAHandle handle);
+
+  /*
+   * Returns the object a handle refers to, nullptr if it is stale or names no block
+   *
+   * The page id and slot are bounds checked, the block must be in use and, with hbExtended, its use counter has to
+   * still match the generation. Without hbExtended headers the generation is always 0 and only the first two are
+   * checked. A stale handle goes unnoticed if its slot has since been reused exactly a multiple of
+   * 2^HANDLE_GENERATION_BITS times (or its page id was given to a new page whose block matches by chance).
+   */
+  void* Resolve(OAHandle handle) const;
+
+  /*
+   * Returns the handle of an object in use, NULL_HANDLE if it isn't one of ours
+   */
+  OAHandle HandleOf(const void* object) const;
+
+  /**
+   * @brief Bits of a handle holding the generation, the slot and the page id share the rest
+   */
+  static constexpr u32 HANDLE_GENERATION_BITS = 8;
+
+  /**
+   * @brief One page seen through PageIterator: where its blocks are and which of them are in use
+   */
+  struct LivePage {
+    u8* first_block;   //!< First block (object) of the page
+    usize block_size;  //!< Bytes from one block to the next
+    usize blocks;      //!< Blocks carved so far, none past them is in use
+    u32 live;          //!< Blocks in use
+    const u64* in_use; //!< One bit per block, set while the block is owned by the client
+
+    /*
+     * Calls fn(T*) for each block in use on the page, in address order (only the bitmap is read, one word at a time)
+     */
+    template<typename T = void, typename Fn>
+    void ForEachLive(Fn&& fn) const;
+  };
+
+  /**
+   * @brief Walks the pages in address order, a LivePage at a time
+   */
+  class PageIterator {
+  public:
+    PageIterator(const ObjectAllocator& oa, usize index);
+
+    LivePage operator*() const;
+    PageIterator& operator++();
+    bool operator==(const PageIterator& rhs) const;
+    bool operator!=(const PageIterator& rhs) const;
+
+  private:
+    const ObjectAllocator* oa; //!< Allocator whose page directory is walked
+    usize index;               //!< Position in the page directory
+  };
+
+  /**
+   * @brief Range over every page, for range based for loops
+   */
+  struct PageRange {
+    PageIterator first; //!< First page
+    PageIterator last;  //!< One past the last page
+
+    PageIterator begin() const { return first; }
+    PageIterator end() const { return last; }
+  };
+
+  /*
+   * Calls fn(T*) for each block still in use, page by page in address order
+   *
+   * Unlike DumpMemoryInUse fn can be any callable (and gets inlined), headers are never read and free blocks are
+   * skipped a bitmap word (64 blocks) at a time. fn must not allocate or free from this allocator. Visits nothing
+   * with UseCPPMemManager_.
+   */
+  template<typename T = void, typename Fn>
+  void ForEachLive(Fn&& fn) const;
+
+  /*
+   * Returns the pages in address order (the range is invalidated by anything that adds or frees a page)
+   */
+  PageRange Pages() const;
+
+  /*
+   * Returns true if the address lies inside one of the pages owned by this allocator
+   *
+   * Always false when by-passing the OA (UseCPPMemManager_), there are no pages to own.
+   */
+  bool Owns(const void* ptr) const;
+
+  /*
+   * Returns the alignment every page start is guaranteed to have (blocks are aligned relative to it)
+   *
+   * With UseCPPMemManager_ blocks come straight from new[], which only aligns on alignof(std::max_align_t).
+   */
+  usize PageAlignment() const;
+
   /*
    * Returns true if FreeEmptyPages and alignments are implemented
    */
@@ -372,25 +815,326 @@ public:
 
 private:
 
+  /**
+   * @brief Bookkeeping for one page, kept outside of the page itself so the page layout stays untouched
+   */
+  struct PageInfo {
+    u8* page;      //!< Start of the page (the next page pointer)
+    u64* in_use;   //!< One bit per block, set while the block is owned by the client
+    u32 live;      //!< Number of blocks on this page owned by the client
+    u32 carved;      //!< Blocks handed out by the bump pointer so far, the rest have never been touched
+    u64 empty_since; //!< When FreeEmptyPages first kept this page while empty (ms), 0 while it is not retained
+    bool released;   //!< Marked while FreeEmptyPages is releasing this page
+    u8* free_blocks;          //!< This page's own free list (apFullestPage, the single free list is not used then)
+    PageInfo* prev_partial;   //!< Neighbours in the occupancy bucket the page is on (apFullestPage)
+    PageInfo* next_partial;   //!< Neighbours in the occupancy bucket the page is on (apFullestPage)
+    u32 bucket;               //!< Occupancy bucket the page is on, 0 while it has no free block (apFullestPage)
+    u32 id;                   //!< Slot in the page table, stable for the page's lifetime (handles name pages by it)
+    u32* sites;               //!< Profile site that allocated each block in use (Profile_, nullptr otherwise)
+    u32 samples;              //!< Sampled blocks in use on the page
+    u64 sample_filter;        //!< A hashed bit per sampled block, frees only look in the sample table if theirs is set
+  };
+
+  /**
+   * @brief Stack of a sampled block (SampleInterval_)
+   */
+  struct HeapSample {
+    const char* label;              //!< Interned label it was allocated with (nullptr if none)
+    u32 depth;                      //!< Frames in stack
+    void* stack[HEAP_SAMPLE_DEPTH]; //!< Return addresses, innermost first
+  };
+
+  /**
+   * @brief Captures the stack of a block and adds it to the sample table (kept out of line, it is rare)
+   */
+  void sample_block(PageInfo& info, const u8* block, const char* label, const void* caller);
+
+  /**
+   * @brief Adds a block to the sample table (growing it), nullptr if out of memory
+   */
+  HeapSample* insert_sample(PageInfo& info, const u8* block);
+
+  /**
+   * @brief Drops the sample of a block being freed, if it has one
+   */
+  void forget_sample(PageInfo& info, const u8* block);
+
+  /**
+   * @brief Slot of a block in the sample table, or the empty slot it would go in
+   */
+  usize sample_slot(const u8* block) const;
+
+  /**
+   * @brief Allocations until the next sample, geometric with a mean of SampleInterval_
+   */
+  u64 next_sample_countdown();
+
+  /**
+   * @brief Running totals for one label and call site (Profile_)
+   */
+  struct ProfileSite {
+    const char* key;    //!< Label pointer as given to Allocate, compared before the contents on lookups
+    const char* label;  //!< Interned label (nullptr if none)
+    const void* caller; //!< Return address of the Allocate call
+    u64 allocations;    //!< Objects allocated
+    u64 deallocations;  //!< Objects freed
+  };
+
+  /**
+   * @brief Allocate for a known caller, shared by Allocate and AllocateHandle so the profile sees the client
+   */
+  void* allocate(const char* label, const void* caller);
+
+  /**
+   * @brief Site for a label and caller, added on first use (Profile_)
+   */
+  u32 profile_site(const char* label, const void* caller);
+
+  /**
+   * @brief Records that a site allocated a block (Profile_)
+   */
+  void profile_allocation(PageInfo& info, const u8* block, u32 site);
+
+  /**
+   * @brief Credits a free to the site that allocated the block (Profile_)
+   */
+  void profile_free(PageInfo& info, const u8* block);
+
+  /**
+   * @brief One row per site, or per label with every site of that label merged, in no particular order
+   */
+  usize profile_rows(OAProfileEntry* rows, PROFILE_GROUPING grouping) const;
+
+  /**
+   * @brief Number of 64 bit words in the in use bitmap of each page
+   */
+  usize bitmap_words() const;
+
+  /**
+   * @brief Index of the lowest set bit (bits is not 0)
+   */
+  static usize lowest_bit(u64 bits);
+
+  /**
+   * @brief Block a handle names (page id and slot in range, nothing else checked), nullptr if it names none
+   */
+  const u8* handle_block(OAHandle handle) const;
+
+  /**
+   * @brief Generation of a block: the low bits of its hbExtended use counter, 0 with any other header
+   */
+  u32 generation_of(const u8* block) const;
+
+  /**
+   * @brief Index of a block inside of its page
+   */
+  usize block_index(const PageInfo& info, const u8* block) const;
+
+  /**
+   * @brief Sets or clears the in use bit of a block, keeping the page's live count in sync
+   */
+  void set_in_use(const u8* block, bool in_use);
+
+  /**
+   * @brief Sets or clears the in use bit of a block on a known page, keeping the page's live count in sync
+   */
+  void set_in_use(PageInfo& info, const u8* block, bool in_use);
+
+  /**
+   * @brief Puts a free block back on its free list: the single one, or its page's with apFullestPage
+   */
+  void push_free_block(u8* block, PageInfo* info);
+
+  /**
+   * @brief Moves a page to the occupancy bucket matching its live count (off the buckets while it has no free block)
+   */
+  void rebucket(PageInfo& info);
+
+  /**
+   * @brief Takes a page off its occupancy bucket
+   */
+  void unlink_partial(PageInfo& info);
+
+  /**
+   * @brief Most occupied page that has a free block, nullptr if there is none (apFullestPage)
+   */
+  PageInfo* fullest_partial_page() const;
+
+  /**
+   * @brief Claims a free block of a page for Compact (marked in use): off its own list (apFullestPage), or the first
+   * clear bit at or after cursor (apLifo, the block stays on the free list until drop_in_use_free_blocks)
+   */
+  u8* claim_free_block(PageInfo& info, usize& cursor);
+
+  /**
+   * @brief Copies an object in use to a claimed block (off the free list by now), the source becomes a free block
+   */
+  void move_block(PageInfo& from_info, u8* from, u8* to);
+
+  /**
+   * @brief Unlinks the blocks Compact claimed from the free list (apLifo)
+   */
+  void drop_in_use_free_blocks();
+
+  /**
+   * @brief Page of a block, skipping the directory search when it is on the same page as the last one (hint)
+   */
+  PageInfo* page_of(const u8* block, PageInfo* hint) const;
+
+  /**
+   * @brief Validates, unlinks and frees one (address sorted) chunk of a FreeBatch
+   */
+  void free_batch_chunk(u8** blocks, usize count);
+
+  /**
+   * @brief Finds the page that contains the given address, O(log pages), safe for any address
+   *
+   * @return nullptr if the address is not inside any page
+   */
+  PageInfo* find_page(const u8* ptr) const;
+
+  /**
+   * @brief Page of an address known to be inside of one of our pages, O(1) by masking for pbMapped pages
+   */
+  PageInfo* owner_of(const u8* ptr) const;
+
+  /**
+   * @brief Gets the memory for a new page from the configured backend (throws E_NO_MEMORY)
+   */
+  u8* map_page() const;
+
+  /**
+   * @brief Gives the memory of a page back to the configured backend
+   */
+  void unmap_page(u8* page) const;
+
+  /**
+   * @brief Slot at the end of a pbMapped page's span that points back at its PageInfo
+   */
+  PageInfo*& back_pointer(const u8* page) const;
+
+  /**
+   * @brief Makes sure the page directory has room for one more page (throws E_NO_MEMORY)
+   */
+  void reserve_page_directory();
+
+  /**
+   * @brief Inserts a page into the (address sorted) page directory, capacity must already be reserved
+   */
+  void register_page(PageInfo* info);
+
+  /**
+   * @brief Frees a page's bookkeeping
+   */
+  static void delete_page_info(PageInfo* info);
+
+  /**
+   * @brief Address of the first block (user pointer) of a page
+   */
+  u8* first_block(u8* page) const;
+
+  /**
+   * @brief Address of the first block (user pointer) of a page
+   */
+  const u8* first_block(const u8* page) const;
+
+  /**
+   * @brief Allocate for ConcurrentFreeList_, pops the lock-free free list
+   */
+  void* allocate_concurrent(const char* label);
+
+  /**
+   * @brief Free for ConcurrentFreeList_, pushes onto the lock-free free list
+   */
+  void free_concurrent(u8* block);
+
+  /**
+   * @brief Pops a block off of the lock-free free list, growing a page (under the page lock) when it runs dry
+   */
+  u8* pop_concurrent();
+
+  /**
+   * @brief Pushes a chain of blocks (first -> ... -> last) onto the lock-free free list with a single CAS
+   */
+  void push_concurrent(u8* first, u8* last);
+
+  /**
+   * @brief Recomputes the in use bitmaps and live counts from the lock-free free list (needs quiescence)
+   *
+   * Allocate/Free skip the per page bookkeeping in ConcurrentFreeList_ mode so they never touch the page directory.
+   */
+  void rebuild_page_bookkeeping() const;
+
+  /**
+   * @brief Sums the counter stripes into the statistics snapshot, caller must hold the page lock
+   */
+  void snapshot_concurrent_stats() const;
+
+  /**
+   * @brief Counter stripe used by the calling thread
+   */
+  static usize stat_stripe();
+
+  /**
+   * @brief Packs a pointer with the next ABA tag after the one in `previous`
+   */
+  static u64 tag_pointer(const u8* ptr, u64 previous);
+
+  /**
+   * @brief Pointer half of a tagged pointer
+   */
+  static u8* untag_pointer(u64 tagged);
+
+  /**
+   * @brief Signs a block that is being handed to the client (debug only)
+   */
+  void sign_allocated(u8* block) const;
+
+  /**
+   * @brief Takes the next block, off of the free list first then the bump pointer, growing a page if needed
+   */
+  u8* take_block();
+
+  /**
+   * @brief Hands out the next untouched block of a lazily initialised page, signing it and its header
+   */
+  u8* carve_block(PageInfo& info);
+
   /**
    * @brief Validates that a given block is on a valid boundry
    */
   auto validate_boundary(const u8* block) const -> void;
 
   /**
-   * @brief Checks if the page has no empty blocks
+   * @brief Checks if the page has no blocks in use, O(1)
    */
-  bool is_page_empty(u8* page) const;
+  static bool is_page_empty(const PageInfo& info);
 
   /* @brief
    * Frees a given page (does not fix the linked list pointers)
    */
-  void free_page(u8* page) const;
+  void free_page(u8* page);
 
   /**
-   * @brief Remove all free blocks on the free list that match the given pge
+   * @brief Marks the empty pages FreeEmptyPages should release, keeping up to RetainEmptyPages_ that are not idle
+   *
+   * @return Number of empty pages retained
    */
-  void cull_free_blocks_in_page(const u8* page);
+  usize mark_pages_to_release();
+
+  /**
+   * @brief Unlinks, frees and drops from the directory every page marked as released
+   *
+   * @param released_blocks Number of blocks on the released pages
+   */
+  void release_marked_pages(usize released_blocks);
+
+  /**
+   * @brief Remove all free blocks on the free list that belong to a page marked for release
+   *
+   * @param count Number of blocks on released pages, the walk stops as soon as they have all been unlinked
+   */
+  void cull_free_blocks_in_released_pages(usize count);
 
   /**
    * @brief Converts bytes to a generic object reference
@@ -413,11 +1157,11 @@ private:
   static u8* as_bytes(GenericObject* bytes);
 
   /**
-   * @brief Initialise all header blocks for the given page
+   * @brief Copies the signed block image over every block of a new page (headers, pads, objects, inter alignment)
    *
-   * @parma first_header Pointer to the first header of the first block of a page
+   * @param first_header Pointer to the first header of the first block of a page
    */
-  void init_header_blocks_for_page(u8* first_header) const;
+  void sign_page_blocks(u8* first_header) const;
 
   /**
    * @brief Allocates data for a new page and sets the next pointer for you (this also memsets to UNALLOCATED_PATTERn)
@@ -425,7 +1169,7 @@ private:
   void allocate_page();
 
   /**
-   * @brief Checks if the given block is inside the free list
+   * @brief Checks if the given block is inside the free list, O(1) (headers or the in use bitmap)
    */
   bool is_in_free_list(const u8* ptr) const;
 
@@ -442,15 +1186,20 @@ private:
   /**
    * @brief Book keeping for the header of a block being allocated
    */
-  void setup_allocated_header(u8* header, const char* label) const;
+  void setup_allocated_header(u8* header, const char* label, u32 alloc_num);
 
   /**
    * @brief Book keeping for the header of a block being freed
    */
-  void setup_freed_header(u8* header) const;
+  void setup_freed_header(u8* header);
 
   /**
-   * @brief Checks if all bytes in the given span match the pattern
+   * @brief Holds external_lock in ConcurrentFreeList_ mode, nothing otherwise
+   */
+  std::unique_lock<std::mutex> external_guard();
+
+  /**
+   * @brief Checks if all bytes in the given span match the pattern, long spans use the widest SIMD kernel available
    */
   static bool is_signed_as(const u8* ptr, usize extents, u8 pattern);
 
@@ -464,6 +1213,140 @@ private:
    */
   u8* free_list{nullptr};
 
+  /**
+   * @brief A freshly signed block (zeroed header, pads, unallocated object, aligned), copied onto new pages
+   */
+  u8* block_image{nullptr};
+
+  /**
+   * @brief Occupancy buckets pages in use with a free block are kept on (apFullestPage), above the empty bucket
+   */
+  static constexpr u32 OCCUPANCY_BUCKETS = 16;
+
+  /**
+   * @brief Bucket of the pages with no block in use, the lowest so they are only taken from once no page in use has
+   *        room (and stay empty for FreeEmptyPages otherwise). Bucket 0 is unused.
+   */
+  static constexpr u32 EMPTY_BUCKET = 1;
+
+  /**
+   * @brief Pages with a free block by occupancy bucket (the fuller the page the higher the bucket)
+   */
+  PageInfo* partial_pages[EMPTY_BUCKET + OCCUPANCY_BUCKETS + 1]{};
+
+  /**
+   * @brief Bit n is set while bucket n holds a page, the fullest page is found from the highest bit
+   */
+  u32 partial_mask{0};
+
+  /**
+   * @brief Page being carved by the bump pointer (LazyPageInit_), nullptr once all of its blocks are handed out
+   */
+  PageInfo* bump_page{nullptr};
+
+  /**
+   * @brief Every page sorted by address, used to find the owner of a block without walking the page list
+   */
+  PageInfo** page_directory{nullptr};
+
+  /**
+   * @brief Start of every page in the page directory (same order), searched instead so lookups stay in a few lines
+   */
+  const u8** page_starts{nullptr};
+
+  /**
+   * @brief Pages by id (same capacity as the directory), a released page's slot is nullptr until reused
+   */
+  PageInfo** page_table{nullptr};
+
+  /**
+   * @brief Profile sites in the order they were added, blocks refer to them by index (Profile_)
+   */
+  ProfileSite* profile_sites{nullptr};
+
+  /**
+   * @brief Number of profile sites
+   */
+  u32 profile_site_count{0};
+
+  /**
+   * @brief Capacity of profile_sites
+   */
+  u32 profile_site_capacity{0};
+
+  /**
+   * @brief Open addressed table from (label, caller) to site index + 1 (0 is an empty slot), a power of two in size
+   */
+  u32* profile_index{nullptr};
+
+  /**
+   * @brief Slots in profile_index
+   */
+  usize profile_index_size{0};
+
+  /**
+   * @brief When the profile started (ms), for the allocation rates
+   */
+  u64 profile_started{0};
+
+  /**
+   * @brief Sampled blocks, open addressed by address (linear probing), a power of two in size (SampleInterval_)
+   *
+   * Probes only read this, the stacks (heap_samples, same slots) are a few hundred bytes each.
+   */
+  const u8** heap_sample_blocks{nullptr};
+
+  /**
+   * @brief Stack of each sampled block, by the slot of the block in heap_sample_blocks
+   */
+  HeapSample* heap_samples{nullptr};
+
+  /**
+   * @brief Slots in heap_samples
+   */
+  usize heap_sample_capacity{0};
+
+  /**
+   * @brief Sampled blocks in use
+   */
+  usize heap_sample_count{0};
+
+  /**
+   * @brief Labels of external headers, profile sites and heap samples, and the records of external headers (a page
+   * worth of records at a time), trimmed by FreeEmptyPages
+   */
+  MemBlockInfoPool block_infos;
+
+  /**
+   * @brief Guards block_infos in ConcurrentFreeList_ mode
+   */
+  std::mutex external_lock;
+
+  /**
+   * @brief Allocations left until the next sample
+   */
+  u64 sample_countdown{0};
+
+  /**
+   * @brief State of the xorshift generator drawing the sampling gaps
+   */
+  u64 sample_random{0x9E3779B97F4A7C15UL};
+
+  /**
+   * @brief Bits of a handle holding the slot, enough for ObjectsPerPage_ - 1
+   */
+  u32 handle_slot_bits{0};
+
+  /**
+   * @brief Number of pages in the page directory
+   */
+  usize page_count{0};
+
+  /**
+   * @brief Number of pages the page directory can hold before growing
+   */
+  usize page_capacity{0};
+
   /**
    * @brief Config for allocator
    */
@@ -489,7 +1372,113 @@ private:
    */
   usize block_size{0};
 
+  /**
+   * @brief Bytes reserved for each pbMapped page, a power of two that every page is aligned on (0 for pbHeap)
+   */
+  usize page_span{0};
+
+  /**
+   * @brief Counters for one group of threads, padded out to its own cache line
+   */
+  struct StatStripe {
+    std::atomic<unsigned> allocations;   //!< Allocations made by threads on this stripe
+    std::atomic<unsigned> deallocations; //!< Deallocations made by threads on this stripe
+    u8 padding[CACHE_LINE_SIZE - 2 * sizeof(std::atomic<unsigned>)];
+  };
+
+  /**
+   * @brief Number of counter stripes threads are spread over in ConcurrentFreeList_ mode
+   */
+  static constexpr usize STAT_STRIPES = 16;
+
+  /**
+   * @brief Bits of a tagged free list pointer that hold the address, the rest is the ABA tag
+   */
+  static constexpr u64 TAG_POINTER_BITS = 48;
+
+  /**
+   * @brief Free list for ConcurrentFreeList_, a Treiber stack head tagged against ABA
+   */
+  std::atomic<u64> concurrent_free_list{0};
+
+  /**
+   * @brief Guards page growth (and the page directory) in ConcurrentFreeList_ mode
+   */
+  mutable std::mutex page_lock;
+
+  /**
+   * @brief Striped allocation / deallocation counters in ConcurrentFreeList_ mode (nullptr otherwise)
+   */
+  StatStripe* stat_stripes{nullptr};
+
+  /**
+   * @brief Pushes a chain of blocks (already linked first to last) onto the remote free queue
+   */
+  void push_remote(u8* first, u8* last);
+
+  /**
+   * @brief Whether a Free from the calling thread has to go through the remote free queue
+   */
+  bool is_remote_free() const;
+
+  /**
+   * @brief Blocks freed by other threads in RemoteFree_ mode, an MPSC stack: foreign threads push, the owner takes
+   * the whole stack at once (so there is no ABA to guard against)
+   */
+  std::atomic<u8*> remote_free_list{nullptr};
+
+  /**
+   * @brief Thread allowed to touch the free list and pages directly in RemoteFree_ mode
+   */
+  std::thread::id owner_thread{std::this_thread::get_id()};
+
+  /**
+   * @brief Allocation numbers for header blocks in ConcurrentFreeList_ mode
+   */
+  std::atomic<u32> allocation_ticket{0};
+
+  /**
+   * @brief Statistics handed out by GetStats in ConcurrentFreeList_ mode, built from the counter stripes
+   */
+  mutable OAStats concurrent_stats{};
+
   // Lots of other private stuff...
 };
 
+inline usize ObjectAllocator::lowest_bit(const u64 bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<usize>(__builtin_ctzll(bits));
+#else
+  usize index{0};
+
+  while ((bits & (u64{1} << index)) == 0) {
+    index++;
+  }
+
+  return index;
+#endif
+}
+
+template<typename T, typename Fn>
+void ObjectAllocator::LivePage::ForEachLive(Fn&& fn) const {
+  for (usize word = 0; word * 64 < blocks; word++) {
+    for (u64 bits = in_use[word]; bits != 0; bits &= bits - 1) {
+      fn(static_cast<T*>(static_cast<void*>(first_block + (word * 64 + lowest_bit(bits)) * block_size)));
+    }
+  }
+}
+
+template<typename T, typename Fn>
+void ObjectAllocator::ForEachLive(Fn&& fn) const {
+  if (config.ConcurrentFreeList_) {
+    rebuild_page_bookkeeping();
+  }
+
+  for (const LivePage page : Pages()) {
+    if (page.live != 0) {
+      page.ForEachLive<T>(fn);
+    }
+  }
+}
+
 #endif
@@ -0,0 +1,106 @@
+#include "ObjectPoolResource.h"
+
+#include <new>
+
+ObjectPoolResource::ObjectPoolResource(
+  const OAConfig& config,
+  const usize MaxSize,
+  std::pmr::memory_resource* const upstream
+):
+    config{config}, max_size{MaxSize}, max_alignment{0}, upstream{upstream} {
+
+  // what a page's start is aligned on only grows with the page, so the smallest object's pages are the guarantee
+  try {
+    const ObjectAllocator probe(sizeof(GenericObject), config);
+    max_alignment = probe.PageAlignment();
+  } catch (const OAException&) {
+    throw std::bad_alloc();
+  }
+
+  if (max_alignment > usize{1} << (ALIGNMENT_CLASSES - 1)) {
+    max_alignment = usize{1} << (ALIGNMENT_CLASSES - 1);
+  }
+}
+
+ObjectPoolResource::~ObjectPoolResource() noexcept {
+  for (SizeClassAllocator* classes : by_alignment) {
+    delete classes;
+  }
+}
+
+std::pmr::memory_resource* ObjectPoolResource::upstream_resource() const { return upstream; }
+
+const SizeClassAllocator* ObjectPoolResource::GetClasses(const usize alignment) const {
+  return alignment <= max_alignment ? by_alignment[alignment_index(alignment)] : nullptr;
+}
+
+usize ObjectPoolResource::MaxAlignment() const { return max_alignment; }
+
+OAConfig ObjectPoolResource::DefaultConfig() {
+  OAConfig config(false, DEFAULT_RESOURCE_OBJECTS_PER_PAGE, 0);
+
+#if defined(__unix__) || defined(__APPLE__)
+  config.PageBackend_ = OAConfig::pbMapped;
+#endif
+
+  return config;
+}
+
+void* ObjectPoolResource::do_allocate(const std::size_t bytes, const std::size_t alignment) {
+  if (not is_pooled(bytes, alignment)) {
+    return upstream->allocate(bytes, alignment);
+  }
+
+  SizeClassAllocator*& classes = by_alignment[alignment_index(alignment)];
+
+  try {
+    if (classes == nullptr) {
+      // blocks sit on multiples of Alignment_ from their page, so it is raised to the least common multiple with the
+      // request's alignment (a power of two, only the factors of two Alignment_ lacks are added)
+      OAConfig aligned = config;
+      usize block_alignment = aligned.Alignment_ == 0 ? alignment : aligned.Alignment_;
+
+      while (block_alignment % alignment != 0) {
+        block_alignment *= 2;
+      }
+
+      aligned.Alignment_ = block_alignment == 1 ? 0 : static_cast<unsigned>(block_alignment);
+
+      classes = new SizeClassAllocator(aligned, max_size);
+    }
+
+    return classes->Allocate(bytes);
+  } catch (const OAException&) {
+    throw std::bad_alloc();
+  }
+}
+
+void ObjectPoolResource::do_deallocate(void* const block, const std::size_t bytes, const std::size_t alignment) {
+  if (not is_pooled(bytes, alignment)) {
+    upstream->deallocate(block, bytes, alignment);
+    return;
+  }
+
+  try {
+    by_alignment[alignment_index(alignment)]->Free(block, bytes);
+  } catch (const OAException&) {
+    // deallocate can't report, a block the pools refuse (debug checks) is dropped
+  }
+}
+
+bool ObjectPoolResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept { return this == &other; }
+
+bool ObjectPoolResource::is_pooled(const usize bytes, const usize alignment) const {
+  return bytes <= max_size and alignment <= max_alignment;
+}
+
+usize ObjectPoolResource::alignment_index(usize alignment) {
+  usize index{0};
+
+  while (alignment > 1) {
+    alignment >>= 1;
+    index++;
+  }
+
+  return index;
+}
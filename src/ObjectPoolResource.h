@@ -0,0 +1,133 @@
+#ifndef OBJECTPOOLRESOURCEH
+#define OBJECTPOOLRESOURCEH
+
+#if __cplusplus < 201703L
+  #error "ObjectPoolResource needs C++17, configure with -DOA_PMR=ON"
+#endif
+
+#include "SizeClassAllocator.h"
+
+#include <memory_resource>
+
+// If the client doesn't specify it:
+static constexpr unsigned DEFAULT_RESOURCE_OBJECTS_PER_PAGE = 256;
+
+/**
+ * Polymorphic memory resource serving allocations from ObjectAllocator size classes
+ *
+ * Every alignment gets its own SizeClassAllocator (created on first use) whose pools have OAConfig::Alignment_ set to
+ * that alignment, so do_allocate(bytes, align) is two table lookups. Requests above the largest class, or aligned
+ * more strictly than a cache line (or than the pages themselves are), go to the upstream resource. Like
+ * std::pmr::unsynchronized_pool_resource it must not be used from several threads at once.
+ */
+class ObjectPoolResource final : public std::pmr::memory_resource {
+public:
+
+  /**
+   * @brief Alignments 1, 2, 4, ..., 64 are pooled, padding blocks any further wastes more than going upstream
+   */
+  static constexpr usize ALIGNMENT_CLASSES = 7;
+
+  /**
+   * Creates the resource, size classes are created with config the first time an alignment is requested
+   *
+   * A throwaway allocator built with config tells what its pages are aligned on. Throws std::bad_alloc if it can't be
+   * built.
+   *
+   * @param MaxSize Largest request served from the pools, anything bigger goes upstream
+   *
+   * @param upstream Resource for requests the pools don't serve
+   */
+  explicit ObjectPoolResource(
+    const OAConfig& config = DefaultConfig(),
+    usize MaxSize = DEFAULT_MAX_CLASS_SIZE,
+    std::pmr::memory_resource* upstream = std::pmr::get_default_resource()
+  );
+
+  /*
+   * Destroys every size class (never throws), blocks still in use are lost
+   */
+  ~ObjectPoolResource() noexcept override;
+
+  /**
+   * returns the resource requests the pools don't serve go to
+   */
+  std::pmr::memory_resource* upstream_resource() const;
+
+  /**
+   * returns the size classes for an alignment, nullptr if that alignment was never requested
+   */
+  const SizeClassAllocator* GetClasses(usize alignment) const;
+
+  /**
+   * returns the strictest alignment served from the pools (what the page backend guarantees for a page's start)
+   */
+  usize MaxAlignment() const;
+
+  /**
+   * returns the default config: DEFAULT_RESOURCE_OBJECTS_PER_PAGE objects per page, no page limit and pbMapped pages
+   * where available (aligned on at least the OS page size, and their owner is found by masking)
+   */
+  static OAConfig DefaultConfig();
+
+  // Prevent copy construction and assignment
+
+  ObjectPoolResource(const ObjectPoolResource&) = delete;            //!< Do not implement!
+  ObjectPoolResource(ObjectPoolResource&&) = delete;                 //!< Do not implement!
+  ObjectPoolResource& operator=(const ObjectPoolResource&) = delete; //!< Do not implement!
+  ObjectPoolResource& operator=(ObjectPoolResource&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief Takes a block from the size class for bytes at the given alignment, or from upstream
+   */
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+  /**
+   * @brief Returns a block to its size class (found from bytes and alignment, O(1)), or to upstream
+   */
+  void do_deallocate(void* block, std::size_t bytes, std::size_t alignment) override;
+
+  /**
+   * @brief Only the same resource can free another's blocks
+   */
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+  /**
+   * @brief Whether a request is served from the pools
+   */
+  bool is_pooled(usize bytes, usize alignment) const;
+
+  /**
+   * @brief Index of an alignment (a power of two) in by_alignment
+   */
+  static usize alignment_index(usize alignment);
+
+  /**
+   * @brief Config the size classes are created with
+   */
+  OAConfig config;
+
+  /**
+   * @brief Largest request served from the pools
+   */
+  usize max_size;
+
+  /**
+   * @brief Strictest alignment served from the pools
+   */
+  usize max_alignment;
+
+  /**
+   * @brief Resource for everything else
+   */
+  std::pmr::memory_resource* upstream;
+
+  /**
+   * @brief Size classes for each alignment, created on first use
+   */
+  SizeClassAllocator* by_alignment[ALIGNMENT_CLASSES]{};
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "PoolAllocator.h"
+
+// NOLINTBEGIN(*-exception-baseclass)
+
+namespace {
+  /**
+   * @brief Objects a page of the allocator holds when it fills its whole span (ending in the page's PageInfo pointer)
+   */
+  unsigned objects_to_fill(const ObjectAllocator& allocator) {
+    const OAConfig& config = allocator.GetConfig();
+    const usize block_size = config.HBlockInfo_.size_ + config.PadBytes_ + allocator.GetStats().ObjectSize_ +
+                             config.PadBytes_ + config.InterAlignSize_;
+    // a cache line layout rounds the page up to whole lines, the pointer then takes the span's last line
+    const usize tail = config.CacheLineLayout_ ? CACHE_LINE_SIZE : sizeof(void*);
+    const usize room =
+        allocator.PageAlignment() - tail - sizeof(GenericObject) - config.LeftAlignSize_ + config.InterAlignSize_;
+    const usize objects = room / block_size;
+
+    return objects > static_cast<unsigned>(-1) ? static_cast<unsigned>(-1) : static_cast<unsigned>(objects);
+  }
+} // namespace
+
+ObjectPools::ObjectPools(): config{DefaultConfig()} {}
+
+ObjectPools::ObjectPools(const OAConfig& config): config{config} {}
+
+ObjectPools::~ObjectPools() noexcept {
+  for (const Pool& pool : pools) {
+    delete pool.allocator;
+  }
+}
+
+ObjectAllocator& ObjectPools::Get(const usize size, const usize alignment) {
+  std::lock_guard<std::mutex> guard{lock};
+
+  for (const Pool& pool : pools) {
+    if (pool.size == size and pool.alignment == alignment) {
+      return *pool.allocator;
+    }
+  }
+
+  // the free list link lives in the object, so an object is never smaller than a pointer
+  const usize object_size = size < sizeof(GenericObject) ? sizeof(GenericObject) : size;
+
+  // blocks sit on multiples of Alignment_ from their page, which must be a multiple of the type's alignment too: the
+  // least common multiple, alignment being a power of two it only adds the factors of two Alignment_ lacks
+  OAConfig pool_config = config;
+  usize block_alignment = pool_config.Alignment_ == 0 ? alignment : pool_config.Alignment_;
+
+  while (block_alignment % alignment != 0) {
+    block_alignment *= 2;
+  }
+
+  pool_config.Alignment_ = block_alignment == 1 ? 0 : static_cast<unsigned>(block_alignment);
+
+  ObjectAllocator* allocator{nullptr};
+
+  try {
+    allocator = new ObjectAllocator(object_size, pool_config);
+
+    // offsets only help if the page itself starts on the type's alignment
+    if (allocator->PageAlignment() % alignment != 0) {
+      delete allocator;
+      throw OAException(OAException::E_NO_MEMORY, "Pages can't be aligned for the type");
+    }
+
+    // the whole span is mapped for a page anyway, fill it unless a page limit says how much the pool may hold
+    if (pool_config.PageBackend_ == OAConfig::pbMapped and not pool_config.UseCPPMemManager_ and
+        pool_config.MaxPages_ == 0) {
+      const unsigned objects = objects_to_fill(*allocator);
+
+      if (objects > pool_config.ObjectsPerPage_) {
+        pool_config.ObjectsPerPage_ = objects;
+        delete allocator;
+        allocator = nullptr;
+        allocator = new ObjectAllocator(object_size, pool_config);
+      }
+    }
+
+    pools.push_back(Pool{size, alignment, allocator});
+  } catch (const std::bad_alloc& err) {
+    delete allocator;
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  return *allocator;
+}
+
+const ObjectAllocator* ObjectPools::Find(const usize size, const usize alignment) const {
+  std::lock_guard<std::mutex> guard{lock};
+
+  for (const Pool& pool : pools) {
+    if (pool.size == size and pool.alignment == alignment) {
+      return pool.allocator;
+    }
+  }
+
+  return nullptr;
+}
+
+usize ObjectPools::Count() const {
+  std::lock_guard<std::mutex> guard{lock};
+  return pools.size();
+}
+
+const ObjectAllocator& ObjectPools::GetPool(const usize index) const {
+  std::lock_guard<std::mutex> guard{lock};
+  return *pools[index].allocator;
+}
+
+OAConfig ObjectPools::DefaultConfig() {
+  OAConfig config(false, DEFAULT_POOL_OBJECTS_PER_PAGE, 0);
+
+#if defined(__unix__) || defined(__APPLE__)
+  config.PageBackend_ = OAConfig::pbMapped;
+#endif
+
+  return config;
+}
+
+const std::shared_ptr<ObjectPools>& ObjectPools::Default() {
+  static const std::shared_ptr<ObjectPools> pools = [] {
+    // shared by every thread, and a container may well be destroyed by another thread than the one that filled it
+    OAConfig config = DefaultConfig();
+    config.ConcurrentFreeList_ = true;
+
+    return std::make_shared<ObjectPools>(config);
+  }();
+
+  return pools;
+}
+
+// NOLINTEND(*-exception-baseclass)
@@ -0,0 +1,314 @@
+#ifndef POOLALLOCATORH
+#define POOLALLOCATORH
+
+#include "ObjectAllocator.h"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// If the client doesn't specify it:
+static constexpr unsigned DEFAULT_POOL_OBJECTS_PER_PAGE = 64;
+
+/**
+ * A set of ObjectAllocators, one per object size and alignment, created on first use
+ *
+ * Every PoolAllocator rebound from the same one shares its pools, so a container's nodes, whatever their type, come
+ * from an allocator sized for exactly that node. Creating a pool is guarded by a lock, the pools themselves are only
+ * safe to use from several threads at once with ConcurrentFreeList_.
+ */
+class ObjectPools final {
+public:
+
+  /**
+   * Creates an empty set of pools using DefaultConfig
+   */
+  ObjectPools();
+
+  /**
+   * Creates an empty set of pools, every pool is created with config (its Alignment_ raised to a multiple of the type's
+   * alignment, Get throws if the pages themselves can't be aligned for the type)
+   *
+   * pbMapped pools without a MaxPages_ limit take as many objects per page as their span holds, ObjectsPerPage_ being
+   * the least: the whole span is mapped for the page anyway.
+   */
+  explicit ObjectPools(const OAConfig& config);
+
+  /*
+   * Destroys every pool (never throws), objects still in use are lost
+   */
+  ~ObjectPools() noexcept;
+
+  /*
+   * Returns the pool for objects of the given size and alignment, creating it the first time
+   *
+   * Throws an exception if the pool can't be created. (Memory allocation problem)
+   */
+  ObjectAllocator& Get(usize size, usize alignment);
+
+  /**
+   * returns the pool for objects of the given size and alignment, nullptr if it was never created
+   */
+  const ObjectAllocator* Find(usize size, usize alignment) const;
+
+  /**
+   * returns the number of pools created so far
+   */
+  usize Count() const;
+
+  /**
+   * returns a pool by creation order
+   */
+  const ObjectAllocator& GetPool(usize index) const;
+
+  /**
+   * returns the config pools are created with by default: at least DEFAULT_POOL_OBJECTS_PER_PAGE objects per page, no
+   * page limit, and pbMapped pages where available (containers free nodes all the time, masking finds their page in
+   * O(1))
+   */
+  static OAConfig DefaultConfig();
+
+  /**
+   * returns the pools used by default constructed PoolAllocators, process wide and so created with ConcurrentFreeList_
+   * (any thread may allocate from or free to them)
+   */
+  static const std::shared_ptr<ObjectPools>& Default();
+
+  // Prevent copy construction and assignment
+
+  ObjectPools(const ObjectPools&) = delete;            //!< Do not implement!
+  ObjectPools(ObjectPools&&) = delete;                 //!< Do not implement!
+  ObjectPools& operator=(const ObjectPools&) = delete; //!< Do not implement!
+  ObjectPools& operator=(ObjectPools&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief One pool and the objects it serves
+   */
+  struct Pool {
+    usize size;                 //!< Object size
+    usize alignment;            //!< Object alignment
+    ObjectAllocator* allocator; //!< Pool for the objects
+  };
+
+  /**
+   * @brief Config every pool is created with
+   */
+  OAConfig config;
+
+  /**
+   * @brief Every pool, in creation order
+   */
+  std::vector<Pool> pools;
+
+  /**
+   * @brief Guards pool creation
+   */
+  mutable std::mutex lock;
+};
+
+/**
+ * Standard library allocator backed by ObjectPools
+ *
+ * Single objects (list, map, set and unordered container nodes) come from the pool for their type, anything bigger
+ * (vector storage, bucket arrays) goes to ::operator new. Rebinding keeps the same pools, so copies and rebinds compare
+ * equal and can free each other's nodes. Pool exceptions surface as std::bad_alloc, like any other allocator.
+ *
+ * Not final: standard containers derive from their allocator (empty base optimisation).
+ */
+template<typename T>
+class PoolAllocator {
+public:
+
+  using value_type = T;
+
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  /**
+   * @brief Same pools, other type
+   */
+  template<typename U>
+  struct rebind {
+    using other = PoolAllocator<U>;
+  };
+
+  /**
+   * Uses the default pools (see ObjectPools::Default)
+   *
+   * Throws an exception if the default pools can't be created, the first time only.
+   */
+  PoolAllocator(): pools{ObjectPools::Default()} {}
+
+  /**
+   * Uses the given pools
+   */
+  explicit PoolAllocator(std::shared_ptr<ObjectPools> source) noexcept: pools{std::move(source)} {}
+
+  /**
+   * Rebinds an allocator of another type, sharing its pools
+   */
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other) noexcept: pools{other.GetPools()} {} // NOLINT(*-explicit-constructor)
+
+  /*
+   * Takes n objects, a single one from the pool for T
+   *
+   * Throws std::bad_alloc if the memory can't be allocated, std::bad_array_new_length if n is above max_size().
+   */
+  T* allocate(const usize n) {
+    if (n > max_size()) {
+      throw std::bad_array_new_length();
+    }
+
+    if (n != 1) {
+      return static_cast<T*>(new_array(n * sizeof(T)));
+    }
+
+    try {
+      return static_cast<T*>(pool().Allocate());
+    } catch (const OAException&) {
+      throw std::bad_alloc();
+    }
+  }
+
+  /*
+   * Returns n objects taken by allocate
+   *
+   * A block the pool refuses (debug checks) can't be reported through a noexcept deallocate and is dropped.
+   */
+  void deallocate(T* const ptr, const usize n) noexcept {
+    if (n != 1) {
+      delete_array(ptr);
+      return;
+    }
+
+    try {
+      pool().Free(ptr);
+    } catch (const OAException&) {
+      // nothing sensible to do from inside of a container
+    }
+  }
+
+  /**
+   * returns the largest n allocate accepts (n * sizeof(T) must not overflow)
+   */
+  usize max_size() const noexcept { return static_cast<usize>(-1) / sizeof(T); }
+
+  /**
+   * returns the pools this allocator (and every rebind of it) uses
+   */
+  const std::shared_ptr<ObjectPools>& GetPools() const noexcept { return pools; }
+
+private:
+
+#if defined(__cpp_aligned_new)
+  /**
+   * @brief Takes an array from ::operator new, the aligned overload for an over-aligned T
+   */
+  static void* new_array(const usize bytes) {
+    if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      return ::operator new(bytes, std::align_val_t{alignof(T)});
+    }
+
+    return ::operator new(bytes);
+  }
+
+  /**
+   * @brief Returns an array taken by new_array
+   */
+  static void delete_array(T* const array) noexcept {
+    if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      ::operator delete(array, std::align_val_t{alignof(T)});
+      return;
+    }
+
+    ::operator delete(array);
+  }
+#else
+  /**
+   * @brief Arrays need a stricter alignment than ::operator new gives
+   */
+  static constexpr bool OVER_ALIGNED = alignof(T) > alignof(std::max_align_t);
+
+  /**
+   * @brief Takes an array from ::operator new, an over-aligned one is over-allocated and aligned by hand (no aligned
+   * overload before C++17), the offset to the allocation kept in the usize before the array
+   */
+  static void* new_array(const usize bytes) {
+    if (not OVER_ALIGNED) {
+      return ::operator new(bytes);
+    }
+
+    if (bytes > static_cast<usize>(-1) - alignof(T)) {
+      throw std::bad_alloc();
+    }
+
+    // the allocation is aligned on max_align_t, so the offset is at least that, room enough for itself
+    u8* const memory = static_cast<u8*>(::operator new(bytes + alignof(T)));
+    const usize offset = alignof(T) - reinterpret_cast<uptr>(memory) % alignof(T);
+    memcpy(memory + offset - sizeof(usize), &offset, sizeof(usize));
+    return memory + offset;
+  }
+
+  /**
+   * @brief Returns an array taken by new_array
+   */
+  static void delete_array(T* const array) noexcept {
+    if (not OVER_ALIGNED) {
+      ::operator delete(array);
+      return;
+    }
+
+    u8* const start = reinterpret_cast<u8*>(array);
+    usize offset;
+    memcpy(&offset, start - sizeof(usize), sizeof(usize));
+    ::operator delete(start - offset);
+  }
+#endif
+
+  /**
+   * @brief Pool for T, looked up once per allocator
+   */
+  ObjectAllocator& pool() {
+    if (cached == nullptr) {
+      cached = &pools->Get(sizeof(T), alignof(T));
+    }
+
+    return *cached;
+  }
+
+  /**
+   * @brief Shared between every copy and rebind
+   */
+  std::shared_ptr<ObjectPools> pools;
+
+  /**
+   * @brief Pool for T once looked up
+   */
+  ObjectAllocator* cached{nullptr};
+};
+
+/**
+ * Allocators are equal when they share pools (either one can free the other's objects)
+ */
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) noexcept {
+  return lhs.GetPools() == rhs.GetPools();
+}
+
+/**
+ * Allocators are equal when they share pools (either one can free the other's objects)
+ */
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs) noexcept {
+  return not(lhs == rhs);
+}
+
+#endif
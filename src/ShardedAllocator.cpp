@@ -0,0 +1,523 @@
+#include "ShardedAllocator.h"
+
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <vector>
+
+#if defined(__linux__)
+  #include <sched.h>
+  #include <unistd.h>
+  #define OA_HAS_SCHED_GETCPU 1
+#else
+  #define OA_HAS_SCHED_GETCPU 0
+#endif
+
+#if OA_HAS_SCHED_GETCPU && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && defined(__has_include)
+  #if __has_include(<sys/rseq.h>)
+    #include <sys/rseq.h>
+    #include <cstddef>
+    #define OA_HAS_RSEQ 1
+  #endif
+#endif
+
+#ifndef OA_HAS_RSEQ
+  #define OA_HAS_RSEQ 0
+#endif
+
+// NOLINTBEGIN(*-exception-baseclass)
+
+namespace {
+#if OA_HAS_RSEQ
+  /**
+   * @brief Cache state change of a client allocation: one less cached block, one more allocation served
+   */
+  constexpr u64 CLIENT_POP = (u64{1} << 32) - 1;
+
+  /**
+   * @brief Cache state change of a flush: one less cached block
+   */
+  constexpr u64 FLUSH_POP = ~u64{0};
+
+  /**
+   * @brief The calling thread's rseq area (registered by glibc)
+   */
+  struct rseq* rseq_area() {
+    return reinterpret_cast<struct rseq*>(static_cast<u8*>(__builtin_thread_pointer()) + __rseq_offset);
+  }
+
+  // A CPU cache is a u64 state (cached block count in the low half, client allocations in the high half) followed
+  // by the cached blocks. Both critical sections follow the kernel's rseq selftests: the descriptor lives in
+  // __rseq_cs, the abort handler is preceded by the signature glibc registered and restarts from the top, and the
+  // store of the new state is the single commit instruction. Preempted or migrated before it, nothing happened.
+
+  /**
+   * @brief Pops the current CPU's cache, nullptr when it is empty (or the CPU has no cache)
+   */
+  inline void* cache_pop(u8* const caches, const usize stride, const unsigned cpus, const u64 delta) {
+    void* block;
+
+    asm volatile(
+      ".pushsection __rseq_cs, \"aw\"\n\t"
+      ".balign 32\n\t"
+      "3:\n\t"
+      ".long 0x0, 0x0\n\t"
+      ".quad 1f, (2f - 1f), 4f\n\t"
+      ".popsection\n\t"
+      "6:\n\t"
+      "leaq 3b(%%rip), %%rax\n\t"
+      "movq %%rax, %c[cs_offset](%[rseq])\n\t"
+      "1:\n\t"
+      "movl %c[cpu_offset](%[rseq]), %%eax\n\t"
+      "cmpl %[cpus], %%eax\n\t"
+      "jae 5f\n\t"
+      "imulq %[stride], %%rax\n\t"
+      "addq %[caches], %%rax\n\t"
+      "movq (%%rax), %%rcx\n\t"
+      "testl %%ecx, %%ecx\n\t"
+      "jz 5f\n\t"
+      "movl %%ecx, %%edx\n\t"
+      "movq (%%rax, %%rdx, 8), %[block]\n\t"
+      "addq %[delta], %%rcx\n\t"
+      "movq %%rcx, (%%rax)\n\t"
+      "2:\n\t"
+      "jmp 7f\n\t"
+      ".pushsection __rseq_failure, \"ax\"\n\t"
+      ".byte 0x0f, 0xb9, 0x3d\n\t"
+      ".long 0x53053053\n\t"
+      "4:\n\t"
+      "jmp 6b\n\t"
+      ".popsection\n\t"
+      "5:\n\t"
+      "xorl %k[block], %k[block]\n\t"
+      "7:\n\t"
+      : [block] "=&r"(block)
+      : [rseq] "r"(rseq_area()),
+        [cs_offset] "i"(offsetof(struct rseq, rseq_cs)),
+        [cpu_offset] "i"(offsetof(struct rseq, cpu_id)),
+        [cpus] "r"(cpus),
+        [stride] "r"(stride),
+        [caches] "r"(caches),
+        [delta] "r"(delta)
+      : "rax", "rcx", "rdx", "memory", "cc"
+    );
+
+    return block;
+  }
+
+  /**
+   * @brief Pushes a block on the current CPU's cache, false when it is full (or the CPU has no cache)
+   */
+  inline bool cache_push(u8* const caches, const usize stride, const unsigned cpus, const unsigned capacity, void* block) {
+    unsigned pushed;
+
+    asm volatile(
+      ".pushsection __rseq_cs, \"aw\"\n\t"
+      ".balign 32\n\t"
+      "3:\n\t"
+      ".long 0x0, 0x0\n\t"
+      ".quad 1f, (2f - 1f), 4f\n\t"
+      ".popsection\n\t"
+      "6:\n\t"
+      "leaq 3b(%%rip), %%rax\n\t"
+      "movq %%rax, %c[cs_offset](%[rseq])\n\t"
+      "1:\n\t"
+      "movl %c[cpu_offset](%[rseq]), %%eax\n\t"
+      "cmpl %[cpus], %%eax\n\t"
+      "jae 5f\n\t"
+      "imulq %[stride], %%rax\n\t"
+      "addq %[caches], %%rax\n\t"
+      "movq (%%rax), %%rcx\n\t"
+      "cmpl %[capacity], %%ecx\n\t"
+      "jae 5f\n\t"
+      "movl %%ecx, %%edx\n\t"
+      "movq %[block], 8(%%rax, %%rdx, 8)\n\t"
+      "addq $1, %%rcx\n\t"
+      "movq %%rcx, (%%rax)\n\t"
+      "2:\n\t"
+      "movl $1, %[pushed]\n\t"
+      "jmp 7f\n\t"
+      ".pushsection __rseq_failure, \"ax\"\n\t"
+      ".byte 0x0f, 0xb9, 0x3d\n\t"
+      ".long 0x53053053\n\t"
+      "4:\n\t"
+      "jmp 6b\n\t"
+      ".popsection\n\t"
+      "5:\n\t"
+      "movl $0, %[pushed]\n\t"
+      "7:\n\t"
+      : [pushed] "=&r"(pushed)
+      : [rseq] "r"(rseq_area()),
+        [cs_offset] "i"(offsetof(struct rseq, rseq_cs)),
+        [cpu_offset] "i"(offsetof(struct rseq, cpu_id)),
+        [cpus] "r"(cpus),
+        [stride] "r"(stride),
+        [caches] "r"(caches),
+        [capacity] "r"(capacity),
+        [block] "r"(block)
+      : "rax", "rcx", "rdx", "memory", "cc"
+    );
+
+    return pushed != 0;
+  }
+#endif
+} // namespace
+
+struct ShardedAllocator::Shard {
+  std::mutex lock;                     //!< Guards everything below
+  ObjectAllocator* allocator{nullptr}; //!< Created the first time a thread allocates on this CPU
+  unsigned allocations{0};             //!< Client allocations served by the shard itself (not by the CPU cache)
+  u8 padding[CACHE_LINE_SIZE]{};       //!< Keeps the next shard's lock off this shard's lines
+};
+
+struct ShardedAllocator::Directory {
+  std::shared_timed_mutex lock;  //!< Shared to look a page up, exclusive to record one
+  std::vector<const u8*> starts; //!< Start of every recorded page, sorted by address
+  std::vector<unsigned> owners;  //!< Shard owning each page in starts
+  usize page_size{0};            //!< Size of every page (the shards share a config)
+};
+
+ShardedAllocator::ShardedAllocator(const usize ObjectSize, const OAConfig& config, const unsigned CacheSize):
+    config{config}, object_size{ObjectSize}, cache_size{CacheSize == 0 ? 1 : CacheSize} {
+  long cpus{1};
+
+#if OA_HAS_SCHED_GETCPU
+  // configured rather than online, CPU numbers of CPUs brought online later stay in range
+  cpus = sysconf(_SC_NPROCESSORS_CONF);
+#endif
+
+  shard_count = cpus > 0 ? static_cast<unsigned>(cpus) : 1;
+
+  try {
+    shards = new Shard*[shard_count]{};
+    directory = new Directory;
+
+    for (unsigned i = 0; i < shard_count; i++) {
+      shards[i] = new Shard;
+    }
+
+#if OA_HAS_RSEQ
+    // 0 when glibc could not register (or was told not to), every call then goes through the shards
+    if (__rseq_size > 0) {
+      const usize bytes = (usize{cache_size} + 1) * sizeof(void*);
+
+      // a whole number of lines apart, CPUs never share one
+      cache_stride = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+      cache_memory = new u8[cache_stride * shard_count + CACHE_LINE_SIZE]{};
+
+      const uintptr_t address = reinterpret_cast<uintptr_t>(cache_memory);
+      caches = cache_memory + (CACHE_LINE_SIZE - address % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+    }
+#endif
+
+    // the first shard is created right away so a bad config is reported here, like ObjectAllocator does
+    allocator_of(0);
+    directory->page_size = shards[0]->allocator->GetStats().PageSize_;
+  } catch (const std::bad_alloc& err) {
+    destroy();
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  } catch (const OAException&) {
+    destroy();
+    throw;
+  }
+}
+
+ShardedAllocator::~ShardedAllocator() noexcept { destroy(); }
+
+void* ShardedAllocator::Allocate() {
+#if OA_HAS_RSEQ
+  if (caches) {
+    void* const block = cache_pop(caches, cache_stride, shard_count, CLIENT_POP);
+
+    if (block) {
+      return block;
+    }
+  }
+#endif
+
+  return allocate_from_shard();
+}
+
+void ShardedAllocator::Free(void* const block) {
+  if (block == nullptr) {
+    return;
+  }
+
+#if OA_HAS_RSEQ
+  if (caches) {
+    if (cache_push(caches, cache_stride, shard_count, cache_size, block)) {
+      return;
+    }
+
+    flush_cache();
+
+    // still full if the thread moved to another CPU meanwhile, the block then goes straight to its shard
+    if (cache_push(caches, cache_stride, shard_count, cache_size, block)) {
+      return;
+    }
+  }
+#endif
+
+  free_to_owner(block, current_cpu());
+}
+
+unsigned ShardedAllocator::ShardCount() const { return shard_count; }
+
+bool ShardedAllocator::UsesRseq() const { return caches != nullptr; }
+
+const OAConfig& ShardedAllocator::GetConfig() const { return config; }
+
+OAStats ShardedAllocator::GetStats() const {
+  OAStats stats;
+
+  // a sum of peaks reached at different times, an upper bound (see the header)
+  unsigned cached{0};
+  unsigned allocations{0};
+
+  for (unsigned i = 0; i < shard_count; i++) {
+    Shard& shard = *shards[i];
+
+    {
+      std::lock_guard<std::mutex> guard{shard.lock};
+
+      if (shard.allocator) {
+        const OAStats& shard_stats = shard.allocator->GetStats();
+
+        stats.ObjectSize_ = shard_stats.ObjectSize_;
+        stats.PageSize_ = shard_stats.PageSize_;
+        stats.FreeObjects_ += shard_stats.FreeObjects_;
+        stats.ObjectsInUse_ += shard_stats.ObjectsInUse_;
+        stats.PagesInUse_ += shard_stats.PagesInUse_;
+        stats.MostObjects_ += shard_stats.MostObjects_;
+        stats.RetainedPages_ += shard_stats.RetainedPages_;
+      }
+
+      allocations += shard.allocations;
+    }
+
+    const u64 state = cache_state(i);
+
+    cached += static_cast<unsigned>(state);
+    allocations += static_cast<unsigned>(state >> 32);
+  }
+
+  // every block the client gave back is either cached or back on its shard
+  stats.ObjectsInUse_ -= cached;
+  stats.FreeObjects_ += cached;
+  stats.Allocations_ = allocations;
+  stats.Deallocations_ = allocations - stats.ObjectsInUse_;
+
+  return stats;
+}
+
+OAStats ShardedAllocator::GetShardStats(const unsigned shard) const {
+  std::lock_guard<std::mutex> guard{shards[shard]->lock};
+  return shards[shard]->allocator ? shards[shard]->allocator->GetStats() : OAStats();
+}
+
+unsigned ShardedAllocator::CachedObjects(const unsigned shard) const { return static_cast<unsigned>(cache_state(shard)); }
+
+unsigned ShardedAllocator::current_cpu() const {
+#if OA_HAS_RSEQ
+  if (caches) {
+    return __atomic_load_n(&rseq_area()->cpu_id, __ATOMIC_RELAXED) % shard_count;
+  }
+#endif
+
+#if OA_HAS_SCHED_GETCPU
+  const int cpu = sched_getcpu();
+
+  if (cpu >= 0) {
+    return static_cast<unsigned>(cpu) % shard_count;
+  }
+#endif
+
+  return 0;
+}
+
+ObjectAllocator& ShardedAllocator::allocator_of(const unsigned shard) {
+  if (shards[shard]->allocator == nullptr) {
+    try {
+      shards[shard]->allocator = new ObjectAllocator(object_size, config);
+    } catch (const std::bad_alloc& err) {
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+
+    if (shards[shard]->allocator->GetStats().PagesInUse_ != 0) {
+      record_page(shard);
+    }
+  }
+
+  return *shards[shard]->allocator;
+}
+
+void* ShardedAllocator::allocate_block(const unsigned shard) {
+  ObjectAllocator& allocator = allocator_of(shard);
+  const unsigned pages = allocator.GetStats().PagesInUse_;
+
+  void* const block = allocator.Allocate();
+
+  // at most one page per allocation, and it is the head of the page list
+  if (allocator.GetStats().PagesInUse_ != pages) {
+    record_page(shard);
+  }
+
+  return block;
+}
+
+void ShardedAllocator::record_page(const unsigned shard) noexcept {
+  const u8* const page = static_cast<const u8*>(shards[shard]->allocator->GetPageList());
+
+  std::lock_guard<std::shared_timed_mutex> guard{directory->lock};
+
+  // room first so both inserts below can't throw, without it the page is only found by asking every shard
+  if (directory->starts.size() == directory->starts.capacity()) {
+    try {
+      directory->starts.reserve(directory->starts.size() * 2 + 16);
+      directory->owners.reserve(directory->starts.capacity());
+    } catch (const std::bad_alloc&) {
+      return;
+    }
+  }
+
+  const auto at = std::upper_bound(directory->starts.begin(), directory->starts.end(), page);
+
+  directory->owners.insert(directory->owners.begin() + (at - directory->starts.begin()), shard);
+  directory->starts.insert(at, page);
+}
+
+unsigned ShardedAllocator::find_owner(const void* const block) const {
+  const u8* const ptr = static_cast<const u8*>(block);
+
+  std::shared_lock<std::shared_timed_mutex> guard{directory->lock};
+
+  // the last page starting at or before the block is the only one that can hold it
+  const auto at = std::upper_bound(directory->starts.begin(), directory->starts.end(), ptr);
+
+  if (at == directory->starts.begin() or ptr >= *(at - 1) + directory->page_size) {
+    return shard_count;
+  }
+
+  return directory->owners[static_cast<usize>(at - directory->starts.begin()) - 1];
+}
+
+void* ShardedAllocator::allocate_from_shard() {
+  const unsigned index = current_cpu();
+  Shard& shard = *shards[index];
+
+  std::lock_guard<std::mutex> guard{shard.lock};
+
+  void* const block = allocate_block(index);
+  ObjectAllocator& allocator = *shard.allocator;
+
+  shard.allocations++;
+
+#if OA_HAS_RSEQ
+  if (caches) {
+    const unsigned batch = (cache_size + 1) / 2;
+
+    for (unsigned i = 1; i < batch; i++) {
+      void* cached;
+
+      try {
+        cached = allocate_block(index);
+      } catch (const OAException&) {
+        // a partial refill is still a refill
+        break;
+      }
+
+      if (not cache_push(caches, cache_stride, shard_count, cache_size, cached)) {
+        allocator.Free(cached);
+        break;
+      }
+    }
+  }
+#endif
+
+  return block;
+}
+
+void ShardedAllocator::flush_cache() {
+#if OA_HAS_RSEQ
+  const unsigned batch = (cache_size + 1) / 2;
+  const unsigned cpu = current_cpu();
+
+  // only the top of a cache can be popped in a critical section, so the most recently freed blocks go back
+  for (unsigned i = 0; i < batch; i++) {
+    void* const block = cache_pop(caches, cache_stride, shard_count, FLUSH_POP);
+
+    if (block == nullptr) {
+      break;
+    }
+
+    free_to_owner(block, cpu);
+  }
+#endif
+}
+
+void ShardedAllocator::free_to_owner(void* const block, const unsigned hint) {
+  // there are no pages to own, any shard can hand the block back to delete
+  if (config.UseCPPMemManager_) {
+    Shard& shard = *shards[hint];
+
+    std::lock_guard<std::mutex> guard{shard.lock};
+    allocator_of(hint).Free(block);
+    return;
+  }
+
+  const unsigned owner = find_owner(block);
+
+  if (owner != shard_count) {
+    Shard& shard = *shards[owner];
+
+    std::lock_guard<std::mutex> guard{shard.lock};
+    shard.allocator->Free(block);
+    return;
+  }
+
+  // a page the directory had no room for, or a block that is on no page at all
+  for (unsigned i = 0; i < shard_count; i++) {
+    Shard& shard = *shards[(hint + i) % shard_count];
+
+    std::lock_guard<std::mutex> guard{shard.lock};
+
+    if (shard.allocator and shard.allocator->Owns(block)) {
+      shard.allocator->Free(block);
+      return;
+    }
+  }
+
+  throw OAException(OAException::E_BAD_BOUNDARY, "Block is not on any shard's page");
+}
+
+u64 ShardedAllocator::cache_state(const unsigned shard) const {
+  if (caches == nullptr) {
+    return 0;
+  }
+
+  return __atomic_load_n(reinterpret_cast<const u64*>(caches + shard * cache_stride), __ATOMIC_RELAXED);
+}
+
+void ShardedAllocator::destroy() noexcept {
+  if (shards) {
+    for (unsigned i = 0; i < shard_count; i++) {
+      if (shards[i]) {
+        delete shards[i]->allocator;
+      }
+
+      delete shards[i];
+    }
+  }
+
+  delete[] shards;
+  delete directory;
+  delete[] cache_memory;
+
+  shards = nullptr;
+  directory = nullptr;
+  cache_memory = nullptr;
+  caches = nullptr;
+}
+
+// NOLINTEND(*-exception-baseclass)
@@ -0,0 +1,206 @@
+#ifndef SHARDEDALLOCATORH
+#define SHARDEDALLOCATORH
+
+#include "ObjectAllocator.h"
+
+// If the client doesn't specify it:
+static constexpr unsigned DEFAULT_CPU_CACHE_SIZE = 64;
+
+/**
+ * Per CPU sharded front end for ObjectAllocators
+ *
+ * Every CPU gets a shard: its own ObjectAllocator (free list, pages and statistics) behind a lock, created the first
+ * time a thread allocates on that CPU. Pages stay owned by the shard that created them, a block is always returned
+ * to the shard owning its page: every page is recorded with its shard in one address sorted directory as it is
+ * created, so finding the owner is a single search under a shared lock. Unlike ThreadCachedAllocator nothing is kept
+ * per thread, so memory overhead grows with the number of cores rather than the number of threads.
+ *
+ * On x86-64 Linux with restartable sequences registered (glibc 2.35+ does it for every thread) each CPU also gets
+ * a bounded cache of free blocks in front of its shard. Allocate / Free push and pop that cache inside an rseq
+ * critical section, which the kernel restarts if the thread is preempted or migrated, so the fast path has no
+ * atomic instructions and no lock. The cache is refilled from (and flushed to) the shards in batches of half a
+ * cache. Elsewhere the CPU is found with sched_getcpu and every call takes the shard's lock.
+ *
+ * Blocks sitting in a CPU cache are still "in use" as far as their shard is concerned, so debug checks (double free,
+ * corruption) on a block happen when it is flushed back, not on the Free call itself, and labels are not forwarded.
+ */
+class ShardedAllocator final {
+public:
+
+  /**
+   * Creates one shard per configured CPU, each one creating its ObjectAllocator per the specified values on first use
+   *
+   * Throws an exception if the construction fails. (Memory allocation problem)
+   *
+   * @param CacheSize Maximum number of free blocks cached by each CPU (only used with restartable sequences)
+   */
+  ShardedAllocator(usize ObjectSize, const OAConfig& config, unsigned CacheSize = DEFAULT_CPU_CACHE_SIZE);
+
+  /*
+   * Destroys every shard and the CPU caches (never throws)
+   */
+  ~ShardedAllocator() noexcept;
+
+  /*
+   * Takes a block from the current CPU's cache, or from its shard when the cache is empty (or not used)
+   *
+   * Throws an exception if no object can be allocated.
+   */
+  void* Allocate();
+
+  /*
+   * Returns a block to the current CPU's cache, or to the shard owning its page when the cache is full (or not used)
+   *
+   * Throws an exception if an object returned to its shard can't be freed. (Invalid object)
+   */
+  void Free(void* block);
+
+  /**
+   * returns the number of shards (one per configured CPU)
+   */
+  unsigned ShardCount() const;
+
+  /**
+   * returns true when the fast path goes through the per CPU caches with restartable sequences
+   */
+  bool UsesRseq() const;
+
+  /**
+   * returns the configuration parameters of the shards
+   */
+  const OAConfig& GetConfig() const;
+
+  /**
+   * returns the statistics aggregated across every shard, blocks cached by the CPUs count as free objects
+   *
+   * MostObjects_ is the sum of every shard's peak, an upper bound of the real peak: shards peak at different times, and
+   * tracking one peak across all of them would take a shared counter on every call.
+   */
+  OAStats GetStats() const;
+
+  /**
+   * returns the statistics of one shard's allocator (all zero if no thread has allocated on that CPU yet)
+   */
+  OAStats GetShardStats(unsigned shard) const;
+
+  /**
+   * returns the number of free blocks currently cached by a CPU
+   */
+  unsigned CachedObjects(unsigned shard) const;
+
+  // Prevent copy construction and assignment
+
+  ShardedAllocator(const ShardedAllocator&) = delete;            //!< Do not implement!
+  ShardedAllocator(ShardedAllocator&&) = delete;                 //!< Do not implement!
+  ShardedAllocator& operator=(const ShardedAllocator&) = delete; //!< Do not implement!
+  ShardedAllocator& operator=(ShardedAllocator&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief One CPU's allocator and its lock
+   */
+  struct Shard;
+
+  /**
+   * @brief Every page of every shard, with the shard owning it
+   */
+  struct Directory;
+
+  /**
+   * @brief CPU the calling thread is running on (a hint, it can move right after), always below ShardCount
+   */
+  unsigned current_cpu() const;
+
+  /**
+   * @brief Allocator of a shard, created the first time, caller must hold the shard's lock
+   */
+  ObjectAllocator& allocator_of(unsigned shard);
+
+  /**
+   * @brief Allocates from a shard, recording the page the allocation adds (if any), caller must hold the shard's lock
+   */
+  void* allocate_block(unsigned shard);
+
+  /**
+   * @brief Records the newest page of a shard in the directory (a page it can't make room for is found by a scan)
+   */
+  void record_page(unsigned shard) noexcept;
+
+  /**
+   * @brief Shard owning the page that holds the block per the directory, shard_count when it isn't recorded
+   */
+  unsigned find_owner(const void* block) const;
+
+  /**
+   * @brief Allocates from the current CPU's shard, refilling the CPU cache with half a cache worth of blocks
+   */
+  void* allocate_from_shard();
+
+  /**
+   * @brief Moves half a cache worth of blocks from the current CPU's cache back to the shards owning them
+   */
+  void flush_cache();
+
+  /**
+   * @brief Frees a block to the shard owning its page (the current CPU's shard is tried first)
+   */
+  void free_to_owner(void* block, unsigned hint);
+
+  /**
+   * @brief Cache state of a CPU: number of cached blocks (low half) and client allocations served (high half)
+   */
+  u64 cache_state(unsigned shard) const;
+
+  /**
+   * @brief Deletes every shard and the CPU caches, safe on a partially constructed allocator
+   */
+  void destroy() noexcept;
+
+  /**
+   * @brief Config every shard is created with
+   */
+  OAConfig config;
+
+  /**
+   * @brief Size of the client objects
+   */
+  usize object_size;
+
+  /**
+   * @brief One per configured CPU
+   */
+  Shard** shards{nullptr};
+
+  /**
+   * @brief Page to shard directory
+   */
+  Directory* directory{nullptr};
+
+  /**
+   * @brief Number of shards
+   */
+  unsigned shard_count{0};
+
+  /**
+   * @brief Capacity of each CPU cache
+   */
+  unsigned cache_size;
+
+  /**
+   * @brief Bytes between two CPU caches (a whole number of cache lines)
+   */
+  usize cache_stride{0};
+
+  /**
+   * @brief Allocation holding the CPU caches, nullptr without restartable sequences
+   */
+  u8* cache_memory{nullptr};
+
+  /**
+   * @brief First CPU cache (cache_memory aligned on a cache line)
+   */
+  u8* caches{nullptr};
+};
+
+#endif
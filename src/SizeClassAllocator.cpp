@@ -0,0 +1,226 @@
+#include "SizeClassAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// NOLINTBEGIN(*-exception-baseclass)
+
+SizeClassAllocator::SizeClassAllocator(const OAConfig& config, const usize MaxSize):
+    config{config}, use_cpp_mem_manager{config.UseCPPMemManager_} {
+  const usize largest = MaxSize < CLASS_GRANULE ? usize{CLASS_GRANULE} : MaxSize;
+
+  // count the classes first so every array is allocated once
+  for (usize size = CLASS_GRANULE;; size = next_class_size(size)) {
+    class_count++;
+
+    if (size >= largest) {
+      max_size = size;
+      break;
+    }
+  }
+
+  if (class_count > MAX_CLASSES) {
+    throw OAException(OAException::E_NO_MEMORY, "Too many size classes");
+  }
+
+  try {
+    classes = new ObjectAllocator*[class_count]{};
+    class_sizes = new usize[class_count];
+    lookup = new u8[max_size / CLASS_GRANULE + 1];
+
+    usize size = CLASS_GRANULE;
+
+    for (usize i = 0; i < class_count; i++, size = next_class_size(size)) {
+      class_sizes[i] = size;
+    }
+  } catch (const std::bad_alloc& err) {
+    destroy();
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  // slot 0 is a request of 0 bytes, served by the smallest class
+  usize index = 0;
+
+  for (usize slot = 0; slot <= max_size / CLASS_GRANULE; slot++) {
+    while (class_sizes[index] < slot * CLASS_GRANULE) {
+      index++;
+    }
+
+    lookup[slot] = static_cast<u8>(index);
+  }
+}
+
+SizeClassAllocator::~SizeClassAllocator() noexcept { destroy(); }
+
+void* SizeClassAllocator::Allocate(const usize size, const char* const label) {
+  if (size > max_size) {
+    throw OAException(OAException::E_NO_MEMORY, "Size is larger than the largest size class");
+  }
+
+  const usize index = lookup[(size + CLASS_GRANULE - 1) / CLASS_GRANULE];
+  ObjectAllocator& oa = classes[index] ? *classes[index] : create_class(index);
+  const unsigned pages = oa.GetStats().PagesInUse_;
+
+  // room for a page the allocation may add, recording it can't fail once the block is handed out
+  reserve_page_directory();
+
+  void* const block = oa.Allocate(label);
+
+  // a class grows by at most one page per allocation, and it is the head of its page list
+  if (oa.GetStats().PagesInUse_ != pages) {
+    register_page(index);
+  }
+
+  return block;
+}
+
+void SizeClassAllocator::Free(void* const block) {
+  if (block == nullptr) {
+    return;
+  }
+
+  if (use_cpp_mem_manager) {
+    (classes[0] ? *classes[0] : create_class(0)).Free(block);
+    return;
+  }
+
+  // the last page starting at or before the block is the only one that can hold it
+  const u8* const ptr = static_cast<const u8*>(block);
+  const usize page = static_cast<usize>(std::upper_bound(page_starts, page_starts + page_count, ptr) - page_starts);
+
+  if (page != 0) {
+    ObjectAllocator& oa = *classes[page_classes[page - 1]];
+
+    if (ptr < page_starts[page - 1] + oa.GetStats().PageSize_) {
+      oa.Free(block);
+      return;
+    }
+  }
+
+  throw OAException(OAException::E_BAD_BOUNDARY, "Block is not on any size class page");
+}
+
+void SizeClassAllocator::Free(void* const block, const usize size) {
+  if (size > max_size) {
+    throw OAException(OAException::E_BAD_BOUNDARY, "Size is larger than the largest size class");
+  }
+
+  ObjectAllocator* const oa = classes[lookup[(size + CLASS_GRANULE - 1) / CLASS_GRANULE]];
+
+  // a class that never allocated can't own anything
+  if (oa == nullptr) {
+    if (block == nullptr) {
+      return;
+    }
+
+    throw OAException(OAException::E_BAD_BOUNDARY, "Block is not on any size class page");
+  }
+
+  oa->Free(block);
+}
+
+usize SizeClassAllocator::ClassCount() const { return class_count; }
+
+usize SizeClassAllocator::ClassSize(const usize index) const { return class_sizes[index]; }
+
+usize SizeClassAllocator::ClassOf(const usize size) const { return lookup[(size + CLASS_GRANULE - 1) / CLASS_GRANULE]; }
+
+const ObjectAllocator& SizeClassAllocator::GetClass(const usize index) const {
+  return classes[index] ? *classes[index] : create_class(index);
+}
+
+const OAStats& SizeClassAllocator::GetClassStats(const usize index) const {
+  static const OAStats unused;
+
+  return classes[index] ? classes[index]->GetStats() : unused;
+}
+
+usize SizeClassAllocator::next_class_size(const usize size) {
+  // four classes per doubling: the step is a quarter of the power of two at or below size (never under the granule)
+  usize power = CLASS_GRANULE;
+
+  while (power * 2 <= size) {
+    power *= 2;
+  }
+
+  const usize step = power / 4 < CLASS_GRANULE ? CLASS_GRANULE : power / 4;
+
+  return size + step;
+}
+
+ObjectAllocator& SizeClassAllocator::create_class(const usize index) const {
+  reserve_page_directory();
+
+  try {
+    classes[index] = new ObjectAllocator(class_sizes[index], config);
+  } catch (const std::bad_alloc& err) {
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+
+  if (classes[index]->GetStats().PagesInUse_ != 0) {
+    register_page(index);
+  }
+
+  return *classes[index];
+}
+
+void SizeClassAllocator::reserve_page_directory() const {
+  if (page_count != page_capacity) {
+    return;
+  }
+
+  const usize capacity = page_capacity == 0 ? class_count : page_capacity * 2;
+
+  try {
+    const u8** const starts = new const u8*[capacity];
+    u8* const owners = new u8[capacity];
+
+    if (page_count != 0) {
+      memcpy(starts, page_starts, page_count * sizeof(const u8*));
+      memcpy(owners, page_classes, page_count);
+    }
+
+    delete[] page_starts;
+    delete[] page_classes;
+    page_starts = starts;
+    page_classes = owners;
+    page_capacity = capacity;
+  } catch (const std::bad_alloc& err) {
+    throw OAException(OAException::E_NO_MEMORY, err.what());
+  }
+}
+
+void SizeClassAllocator::register_page(const usize index) const {
+  const u8* const start = static_cast<const u8*>(classes[index]->GetPageList());
+  const usize at = static_cast<usize>(std::upper_bound(page_starts, page_starts + page_count, start) - page_starts);
+
+  memmove(page_starts + at + 1, page_starts + at, (page_count - at) * sizeof(const u8*));
+  memmove(page_classes + at + 1, page_classes + at, page_count - at);
+
+  page_starts[at] = start;
+  page_classes[at] = static_cast<u8>(index);
+  page_count++;
+}
+
+void SizeClassAllocator::destroy() noexcept {
+  if (classes) {
+    for (usize i = 0; i < class_count; i++) {
+      delete classes[i];
+    }
+  }
+
+  delete[] classes;
+  delete[] class_sizes;
+  delete[] lookup;
+  delete[] page_starts;
+  delete[] page_classes;
+
+  page_starts = nullptr;
+  page_classes = nullptr;
+  classes = nullptr;
+  class_sizes = nullptr;
+  lookup = nullptr;
+}
+
+// NOLINTEND(*-exception-baseclass)
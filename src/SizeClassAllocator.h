@@ -0,0 +1,173 @@
+#ifndef SIZECLASSALLOCATORH
+#define SIZECLASSALLOCATORH
+
+#include "ObjectAllocator.h"
+
+// If the client doesn't specify it:
+static constexpr usize DEFAULT_MAX_CLASS_SIZE = 1024;
+
+/**
+ * Variable sized allocations served by one ObjectAllocator per size class
+ *
+ * Classes grow geometrically, four per doubling (16, 32, 48, 64, 80, ..., 128, 160, 192, ...), so a request wastes at
+ * most a quarter of its block. A request is mapped to its class with a single table lookup, and a block is freed
+ * through the class whose pages contain it, so no size is stored next to the object. Every page of every class is
+ * recorded (with its class) in one address sorted directory, so an unsized Free is a single search of it. The
+ * allocator of a class is only created on its first allocation.
+ */
+class SizeClassAllocator final {
+public:
+
+  static constexpr usize CLASS_GRANULE = 16; //!< Smallest class, and the step of the lookup table
+  static constexpr usize MAX_CLASSES = 255;  //!< Class indices are stored in a byte
+
+  /**
+   * Sets up the size classes up to MaxSize, the ObjectAllocator of each is created (with config) on first use
+   *
+   * Throws an exception if the construction fails. (Memory allocation problem)
+   */
+  explicit SizeClassAllocator(const OAConfig& config, usize MaxSize = DEFAULT_MAX_CLASS_SIZE);
+
+  /*
+   * Destroys every class (never throws)
+   */
+  ~SizeClassAllocator() noexcept;
+
+  /*
+   * Allocates a block of at least size bytes from the smallest class that fits
+   *
+   * Throws an exception if the block can't be allocated, or size is larger than the largest class (E_NO_MEMORY)
+   */
+  void* Allocate(usize size, const char* label = 0);
+
+  /*
+   * Returns a block to the class whose pages contain it, O(log pages) with a binary search of the page directory
+   *
+   * Throws an exception if no class owns the block (E_BAD_BOUNDARY), or its class can't free it.
+   * When by-passing the OA (UseCPPMemManager_) there are no pages to search, and the block is handed to the first class.
+   */
+  void Free(void* block);
+
+  /*
+   * Returns a block whose requested size is known, the class is found by the lookup table instead, O(1)
+   *
+   * Throws an exception if the block can't be freed. (Invalid object)
+   */
+  void Free(void* block, usize size);
+
+  /**
+   * returns the number of size classes
+   */
+  usize ClassCount() const;
+
+  /**
+   * returns the block size of a class (the largest request it serves)
+   */
+  usize ClassSize(usize index) const;
+
+  /**
+   * returns the index of the class serving requests of the given size (size must not be above the largest class)
+   */
+  usize ClassOf(usize size) const;
+
+  /**
+   * returns the allocator of a class (creating it if it has not been used yet)
+   */
+  const ObjectAllocator& GetClass(usize index) const;
+
+  /**
+   * returns the statistics of a class (all zero if it has not been used yet)
+   */
+  const OAStats& GetClassStats(usize index) const;
+
+  // Prevent copy construction and assignment
+
+  SizeClassAllocator(const SizeClassAllocator&) = delete;            //!< Do not implement!
+  SizeClassAllocator(SizeClassAllocator&&) = delete;                 //!< Do not implement!
+  SizeClassAllocator& operator=(const SizeClassAllocator&) = delete; //!< Do not implement!
+  SizeClassAllocator& operator=(SizeClassAllocator&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief Size of the class after the given one
+   */
+  static usize next_class_size(usize size);
+
+  /**
+   * @brief Creates the allocator of a class on its first use, and records its first page
+   */
+  ObjectAllocator& create_class(usize index) const;
+
+  /**
+   * @brief Makes room for one more page in the page directory
+   */
+  void reserve_page_directory() const;
+
+  /**
+   * @brief Records the newest page of a class in the page directory, keeping it sorted (room must be reserved)
+   */
+  void register_page(usize index) const;
+
+  /**
+   * @brief Destroys the classes created so far
+   */
+  void destroy() noexcept;
+
+  /**
+   * @brief Configuration every class is created with
+   */
+  OAConfig config;
+
+  /**
+   * @brief One allocator per class, smallest first, nullptr until the class is first used
+   */
+  ObjectAllocator** classes{nullptr};
+
+  /**
+   * @brief Block size of each class
+   */
+  usize* class_sizes{nullptr};
+
+  /**
+   * @brief Number of classes
+   */
+  usize class_count{0};
+
+  /**
+   * @brief Class index for every CLASS_GRANULE step of request size, indexed by (size + CLASS_GRANULE - 1) / granule
+   */
+  u8* lookup{nullptr};
+
+  /**
+   * @brief Start of every page of every class, sorted by address
+   */
+  mutable const u8** page_starts{nullptr};
+
+  /**
+   * @brief Class of each page in page_starts
+   */
+  mutable u8* page_classes{nullptr};
+
+  /**
+   * @brief Number of pages in the directory
+   */
+  mutable usize page_count{0};
+
+  /**
+   * @brief Number of pages the directory has room for
+   */
+  mutable usize page_capacity{0};
+
+  /**
+   * @brief Largest request served (the size of the last class)
+   */
+  usize max_size{0};
+
+  /**
+   * @brief Whether the classes by-pass the OA (there are no pages to find owners in)
+   */
+  bool use_cpp_mem_manager{false};
+};
+
+#endif
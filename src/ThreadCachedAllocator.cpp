@@ -0,0 +1,309 @@
+#include "ThreadCachedAllocator.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// NOLINTBEGIN(*-exception-baseclass)
+
+struct ThreadCachedAllocator::Shared {
+  Shared(const usize object_size, const OAConfig& config, const unsigned magazine_size):
+      allocator{new ObjectAllocator(object_size, config)}, magazine_size{magazine_size == 0 ? 1 : magazine_size} {}
+
+  ~Shared() noexcept { delete allocator; }
+
+  std::mutex lock;                   //!< Guards everything below (and the allocator)
+  ObjectAllocator* allocator;        //!< nullptr once the front end has been destroyed
+  std::atomic<bool> alive{true};     //!< Readable without the lock, for pruning dead magazines
+  unsigned magazine_size;            //!< Capacity of each magazine
+  std::vector<Magazine*> magazines;  //!< Every live magazine, for aggregating statistics
+  unsigned retired_allocations{0};   //!< Allocations made by magazines whose thread has exited
+  unsigned retired_deallocations{0}; //!< Deallocations made by magazines whose thread has exited
+  unsigned most_objects{0};          //!< Most objects in use by the client at once
+};
+
+struct ThreadCachedAllocator::Magazine {
+  explicit Magazine(std::shared_ptr<Shared> owner): shared{std::move(owner)}, blocks(shared->magazine_size) {}
+
+  std::shared_ptr<Shared> shared;         //!< Allocator this magazine caches blocks for
+  std::vector<void*> blocks;              //!< Cached blocks, the top is the most recently freed
+  std::atomic<unsigned> count{0};         //!< Number of cached blocks (only written by the owning thread)
+  std::atomic<unsigned> allocations{0};   //!< Client allocations served by this magazine
+  std::atomic<unsigned> deallocations{0}; //!< Client frees taken by this magazine
+};
+
+struct ThreadCachedAllocator::ThreadCaches {
+  ThreadCaches() = default;
+  ThreadCaches(const ThreadCaches&) = delete;
+  ThreadCaches& operator=(const ThreadCaches&) = delete;
+
+  ~ThreadCaches() noexcept {
+    for (Magazine* mag : magazines) {
+      retire(mag);
+    }
+  }
+
+  /**
+   * @brief Flushes a magazine back to its allocator (if it is still around) and unregisters it
+   */
+  static void retire(Magazine* const mag) noexcept {
+    Shared& shared = *mag->shared;
+
+    {
+      std::lock_guard<std::mutex> guard{shared.lock};
+
+      if (shared.allocator) {
+        try {
+          flush(shared, *mag, mag->count.load(std::memory_order_relaxed));
+        } catch (const OAException&) {
+          // nothing sensible to do with a corrupted block while a thread is exiting
+        }
+      }
+
+      shared.retired_allocations += mag->allocations.load(std::memory_order_relaxed);
+      shared.retired_deallocations += mag->deallocations.load(std::memory_order_relaxed);
+
+      for (usize i = 0; i < shared.magazines.size(); i++) {
+        if (shared.magazines[i] == mag) {
+          shared.magazines[i] = shared.magazines.back();
+          shared.magazines.pop_back();
+          break;
+        }
+      }
+    }
+
+    delete mag;
+  }
+
+  std::vector<Magazine*> magazines; //!< One per allocator used by this thread
+  Magazine* last{nullptr};          //!< Most recently used magazine, skips the search in the common case
+};
+
+ThreadCachedAllocator::ThreadCachedAllocator(
+  const usize ObjectSize,
+  const OAConfig& config,
+  const unsigned MagazineSize
+):
+    shared{std::make_shared<Shared>(ObjectSize, config, MagazineSize)} {}
+
+ThreadCachedAllocator::~ThreadCachedAllocator() noexcept {
+  std::lock_guard<std::mutex> guard{shared->lock};
+
+  // magazines of other threads still point into the pages, they are dropped (not flushed) when their thread exits
+  delete shared->allocator;
+  shared->allocator = nullptr;
+  shared->alive.store(false, std::memory_order_relaxed);
+}
+
+void* ThreadCachedAllocator::Allocate() {
+  Magazine& mag = magazine();
+  unsigned count = mag.count.load(std::memory_order_relaxed);
+
+  if (count == 0) {
+    refill(mag);
+    count = mag.count.load(std::memory_order_relaxed);
+  }
+
+  // single writer, plain load + store keeps the fast path free of locked instructions
+  count--;
+  mag.count.store(count, std::memory_order_relaxed);
+  mag.allocations.store(mag.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+  return mag.blocks[count];
+}
+
+void ThreadCachedAllocator::Free(void* const block) {
+  if (block == nullptr) {
+    return;
+  }
+
+  Magazine& mag = magazine();
+  unsigned count = mag.count.load(std::memory_order_relaxed);
+
+  if (count == shared->magazine_size) {
+    std::lock_guard<std::mutex> guard{shared->lock};
+
+    flush(*shared, mag, (count + 1) / 2);
+    count = mag.count.load(std::memory_order_relaxed);
+  }
+
+  mag.blocks[count] = block;
+  mag.count.store(count + 1, std::memory_order_relaxed);
+  mag.deallocations.store(mag.deallocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void ThreadCachedAllocator::Flush() {
+  Magazine& mag = magazine();
+
+  std::lock_guard<std::mutex> guard{shared->lock};
+  flush(*shared, mag, mag.count.load(std::memory_order_relaxed));
+}
+
+const OAConfig& ThreadCachedAllocator::GetConfig() const { return shared->allocator->GetConfig(); }
+
+OAStats ThreadCachedAllocator::GetStats() const {
+  std::lock_guard<std::mutex> guard{shared->lock};
+
+  OAStats stats = shared->allocator->GetStats();
+
+  unsigned cached{0};
+  unsigned allocations{shared->retired_allocations};
+  unsigned deallocations{shared->retired_deallocations};
+
+  for (const Magazine* mag : shared->magazines) {
+    cached += mag->count.load(std::memory_order_relaxed);
+    allocations += mag->allocations.load(std::memory_order_relaxed);
+    deallocations += mag->deallocations.load(std::memory_order_relaxed);
+  }
+
+  stats.ObjectsInUse_ -= cached;
+  stats.FreeObjects_ += cached;
+  stats.Allocations_ = allocations;
+  stats.Deallocations_ = deallocations;
+  stats.MostObjects_ = stats.ObjectsInUse_ > shared->most_objects ? stats.ObjectsInUse_ : shared->most_objects;
+
+  return stats;
+}
+
+ThreadCachedAllocator::Magazine& ThreadCachedAllocator::magazine() {
+  ThreadCaches& caches = thread_caches();
+
+  if (caches.last and caches.last->shared == shared) {
+    return *caches.last;
+  }
+
+  usize kept{0};
+  Magazine* found{nullptr};
+
+  // look for this allocator's magazine, dropping the ones of allocators that have been destroyed on the way
+  for (Magazine* mag : caches.magazines) {
+    if (not mag->shared->alive.load(std::memory_order_relaxed)) {
+      ThreadCaches::retire(mag);
+      continue;
+    }
+
+    if (mag->shared == shared) {
+      found = mag;
+    }
+
+    caches.magazines[kept++] = mag;
+  }
+
+  caches.magazines.resize(kept);
+
+  if (found == nullptr) {
+    found = new Magazine{shared};
+
+    try {
+      caches.magazines.push_back(found);
+
+      std::lock_guard<std::mutex> guard{shared->lock};
+      shared->magazines.push_back(found);
+    } catch (...) {
+      if (not caches.magazines.empty() and caches.magazines.back() == found) {
+        caches.magazines.pop_back();
+      }
+
+      delete found;
+      throw OAException(OAException::E_NO_MEMORY, "Could not register thread cache");
+    }
+  }
+
+  caches.last = found;
+  return *found;
+}
+
+void ThreadCachedAllocator::refill(Magazine& mag) {
+  const unsigned batch = (shared->magazine_size + 1) / 2;
+  unsigned count = mag.count.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard{shared->lock};
+
+  try {
+    shared->allocator->AllocateBatch(&mag.blocks[count], batch);
+    count += batch;
+  } catch (const OAException&) {
+    // the batch hands out all or nothing, take what is left one block at a time (a partial refill is still a refill)
+    for (unsigned i = 0; i < batch; i++) {
+      try {
+        mag.blocks[count] = shared->allocator->Allocate();
+      } catch (const OAException&) {
+        if (i == 0) {
+          throw;
+        }
+
+        break;
+      }
+
+      count++;
+    }
+  }
+
+  mag.count.store(count, std::memory_order_relaxed);
+  update_most_objects(*shared);
+}
+
+void ThreadCachedAllocator::flush(Shared& shared, Magazine& mag, const unsigned count) {
+  const unsigned cached = mag.count.load(std::memory_order_relaxed);
+
+  update_most_objects(shared);
+
+  // the oldest blocks go back, the most recently freed (warmest) ones stay cached
+  unsigned flushed{0};
+
+  while (flushed < count) {
+    const unsigned chunk = count - flushed < ObjectAllocator::FREE_BATCH_CHUNK
+                             ? count - flushed
+                             : static_cast<unsigned>(ObjectAllocator::FREE_BATCH_CHUNK);
+
+    try {
+      // a chunk is validated before any of it is freed, so a throw leaves the whole chunk in the magazine
+      shared.allocator->FreeBatch(&mag.blocks[flushed], chunk);
+      flushed += chunk;
+    } catch (const OAException&) {
+      try {
+        for (const unsigned end = flushed + chunk; flushed < end; flushed++) {
+          shared.allocator->Free(mag.blocks[flushed]);
+        }
+      } catch (const OAException&) {
+        // drop the offending block as well so the magazine never hands it out
+        flushed++;
+
+        for (unsigned i = flushed; i < cached; i++) {
+          mag.blocks[i - flushed] = mag.blocks[i];
+        }
+
+        mag.count.store(cached - flushed, std::memory_order_relaxed);
+        throw;
+      }
+    }
+  }
+
+  for (unsigned i = count; i < cached; i++) {
+    mag.blocks[i - count] = mag.blocks[i];
+  }
+
+  mag.count.store(cached - count, std::memory_order_relaxed);
+}
+
+void ThreadCachedAllocator::update_most_objects(Shared& shared) {
+  const unsigned in_use = objects_in_use(shared);
+  shared.most_objects = in_use > shared.most_objects ? in_use : shared.most_objects;
+}
+
+unsigned ThreadCachedAllocator::objects_in_use(const Shared& shared) {
+  unsigned cached{0};
+
+  for (const Magazine* mag : shared.magazines) {
+    cached += mag->count.load(std::memory_order_relaxed);
+  }
+
+  return shared.allocator->GetStats().ObjectsInUse_ - cached;
+}
+
+ThreadCachedAllocator::ThreadCaches& ThreadCachedAllocator::thread_caches() {
+  thread_local ThreadCaches caches;
+  return caches;
+}
+
+// NOLINTEND(*-exception-baseclass)
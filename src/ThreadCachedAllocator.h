@@ -0,0 +1,129 @@
+#ifndef THREADCACHEDALLOCATORH
+#define THREADCACHEDALLOCATORH
+
+#include "ObjectAllocator.h"
+
+#include <memory>
+
+// If the client doesn't specify it:
+static constexpr unsigned DEFAULT_MAGAZINE_SIZE = 64;
+
+/**
+ * Thread caching front end for an ObjectAllocator
+ *
+ * Every thread gets its own bounded magazine of free blocks, Allocate / Free only touch the shared allocator (and
+ * its lock) when a magazine has to be refilled or flushed, which is done in batches of half a magazine. Magazines
+ * are flushed back automatically when their thread exits.
+ *
+ * Blocks sitting in a magazine are still "in use" as far as the shared ObjectAllocator is concerned, so debug
+ * checks (double free, corruption) on a block happen when it is flushed back, not on the Free call itself, and
+ * labels are not forwarded (blocks leave the shared pool in batches).
+ */
+class ThreadCachedAllocator final {
+public:
+
+  /**
+   * Creates the shared ObjectAllocator per the specified values
+   *
+   * Throws an exception if the construction fails. (Memory allocation problem)
+   *
+   * @param MagazineSize Maximum number of free blocks cached by each thread
+   */
+  ThreadCachedAllocator(usize ObjectSize, const OAConfig& config, unsigned MagazineSize = DEFAULT_MAGAZINE_SIZE);
+
+  /*
+   * Destroys the shared allocator, blocks still cached by other threads are simply forgotten (never throws)
+   */
+  ~ThreadCachedAllocator() noexcept;
+
+  /*
+   * Takes a block from the calling thread's magazine, refilling it from the shared allocator when empty
+   *
+   * Throws an exception if the magazine is empty and no object can be allocated.
+   */
+  void* Allocate();
+
+  /*
+   * Returns a block to the calling thread's magazine, flushing half of it to the shared allocator when full
+   *
+   * Throws an exception if a flushed object can't be freed. (Invalid object)
+   */
+  void Free(void* block);
+
+  /*
+   * Returns every block cached by the calling thread to the shared allocator
+   */
+  void Flush();
+
+  /**
+   * returns the configuration parameters of the shared allocator
+   */
+  const OAConfig& GetConfig() const;
+
+  /**
+   * returns the statistics aggregated across every thread, blocks cached in magazines count as free objects
+   */
+  OAStats GetStats() const;
+
+  // Prevent copy construction and assignment
+
+  ThreadCachedAllocator(const ThreadCachedAllocator&) = delete;            //!< Do not implement!
+  ThreadCachedAllocator(ThreadCachedAllocator&&) = delete;                 //!< Do not implement!
+  ThreadCachedAllocator& operator=(const ThreadCachedAllocator&) = delete; //!< Do not implement!
+  ThreadCachedAllocator& operator=(ThreadCachedAllocator&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief State shared between the front end and every thread's magazine (outlives the front end)
+   */
+  struct Shared;
+
+  /**
+   * @brief One thread's cache of free blocks for one allocator
+   */
+  struct Magazine;
+
+  /**
+   * @brief Every magazine owned by one thread, flushes them all on thread exit
+   */
+  struct ThreadCaches;
+
+  /**
+   * @brief Finds (or creates and registers) the calling thread's magazine for this allocator
+   */
+  Magazine& magazine();
+
+  /**
+   * @brief Moves up to half a magazine worth of blocks from the shared allocator into the magazine (one AllocateBatch)
+   */
+  void refill(Magazine& mag);
+
+  /**
+   * @brief Returns the oldest `count` blocks of a magazine to the shared allocator (FreeBatch), caller holds the lock
+   */
+  static void flush(Shared& shared, Magazine& mag, unsigned count);
+
+  /**
+   * @brief Records the most objects the client has had in use at once, caller must hold the lock
+   */
+  static void update_most_objects(Shared& shared);
+
+  /**
+   * @brief Client visible objects in use (allocator's in use minus blocks cached in magazines), caller must hold the
+   * lock
+   */
+  static unsigned objects_in_use(const Shared& shared);
+
+  /**
+   * @brief The calling thread's caches
+   */
+  static ThreadCaches& thread_caches();
+
+  /**
+   * @brief Shared allocator and bookkeeping
+   */
+  std::shared_ptr<Shared> shared;
+};
+
+#endif
@@ -0,0 +1,617 @@
+#ifndef TYPEDOBJECTALLOCATORH
+#define TYPEDOBJECTALLOCATORH
+
+#include "ObjectAllocator.h"
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// Keeps page growth out of line so the Allocate fast path stays a bare pop
+#if defined(__GNUC__)
+  #define TOA_COLD __attribute__((noinline, cold))
+#else
+  #define TOA_COLD
+#endif
+
+/**
+ * Compile time configuration for a TypedObjectAllocator, the template counterpart of OAConfig
+ *
+ * Everything the ObjectAllocator decides at runtime (headers, padding, alignment, debugging, statistics) is fixed
+ * here, so the checks that are off are dropped by the compiler instead of being branched over on every call.
+ */
+template<
+  OAConfig::HBLOCK_TYPE HeaderType = OAConfig::hbNone,
+  unsigned PadBytes = 0,
+  unsigned Alignment = 0,
+  bool DebugOn = false,
+  bool CollectStats = false,
+  unsigned ObjectsPerPage = DEFAULT_OBJECTS_PER_PAGE,
+  unsigned MaxPages = DEFAULT_MAX_PAGES,
+  unsigned HeaderAdditional = 0>
+struct OAPolicy final {
+  static constexpr OAConfig::HBLOCK_TYPE HeaderType_ = HeaderType; //!< Which of the 4 header types to use
+  static constexpr unsigned HeaderAdditional_ = HeaderAdditional;   //!< User-defined bytes of an hbExtended header
+  static constexpr unsigned PadBytes_ = PadBytes;                   //!< size of the left/right padding for each block
+  static constexpr unsigned Alignment_ = Alignment;                 //!< address alignment of each block
+  static constexpr bool DebugOn_ = DebugOn;                         //!< signatures and Free checks
+  static constexpr bool CollectStats_ = CollectStats;               //!< keep the OAStats counters up to date
+  static constexpr unsigned ObjectsPerPage_ = ObjectsPerPage;       //!< number of objects on each page
+  static constexpr unsigned MaxPages_ = MaxPages;                   //!< maximum number of pages (0=unlimited)
+
+  static_assert(ObjectsPerPage_ != 0, "A page must hold at least one object");
+  static_assert(HeaderType_ == OAConfig::hbExtended or HeaderAdditional_ == 0, "Only extended headers have user bytes");
+};
+
+/**
+ * Header only ObjectAllocator for a single type, specialised at compile time by a policy (see OAPolicy)
+ *
+ * Pages are laid out exactly like the ObjectAllocator's (next page pointer, left alignment, then
+ * [header][pad][object][pad][inter alignment] blocks) and hold the same signatures and headers, but every layout size
+ * is a constant and every check the policy turns off compiles away. With the default policy Allocate and Free are a
+ * bare pop and push of the free list.
+ *
+ * Only the heap page backend is supported, there is no concurrent free list, lazy carving or FreeEmptyPages. Objects
+ * smaller than a pointer take up a pointer (the free list link lives in the object). Blocks are always aligned for T,
+ * the policy's alignment is raised to a multiple of alignof(T) (see ALIGNMENT). External headers point to records of
+ * a MemBlockInfoPool like the ObjectAllocator's, pages are never freed so there are never more records than blocks.
+ */
+template<typename T, typename Policy = OAPolicy<>>
+class TypedObjectAllocator final {
+public:
+
+  /**
+   * @brief Callback function when dumping memory leaks
+   */
+  using DUMPCALLBACK = ObjectAllocator::DUMPCALLBACK;
+
+  /**
+   * @brief Callback function when validating blocks
+   */
+  using VALIDATECALLBACK = ObjectAllocator::VALIDATECALLBACK;
+
+  static constexpr usize OBJECT_SIZE = sizeof(T) < sizeof(GenericObject) ? sizeof(GenericObject) : sizeof(T);
+
+  static constexpr usize HEADER_SIZE = Policy::HeaderType_ == OAConfig::hbBasic ? OAConfig::BASIC_HEADER_SIZE
+                                     : Policy::HeaderType_ == OAConfig::hbExtended
+                                       ? sizeof(u32) + sizeof(u16) + sizeof(u8) + Policy::HeaderAdditional_
+                                     : Policy::HeaderType_ == OAConfig::hbExternal ? OAConfig::EXTERNAL_HEADER_SIZE
+                                                                                   : 0;
+
+  /**
+   * @brief Alignment of every block, the least common multiple of the policy's and alignof(T) (0 when neither asks)
+   * alignof(T) is a power of two, so the lcm is the policy's alignment times the part of alignof(T) it lacks.
+   */
+  static constexpr usize ALIGNMENT =
+    Policy::Alignment_ == 0 ? (alignof(T) == 1 ? 0 : alignof(T))
+    : (Policy::Alignment_ & (0u - Policy::Alignment_)) < alignof(T)
+      ? Policy::Alignment_ / (Policy::Alignment_ & (0u - Policy::Alignment_)) * alignof(T)
+      : Policy::Alignment_;
+
+  static constexpr usize LEFT_ALIGN_SIZE =
+    ALIGNMENT == 0 ? 0
+                   : (ALIGNMENT - (sizeof(GenericObject) + Policy::PadBytes_ + HEADER_SIZE) % ALIGNMENT) % ALIGNMENT;
+
+  static constexpr usize INTER_ALIGN_SIZE =
+    ALIGNMENT == 0 ? 0 : (ALIGNMENT - (OBJECT_SIZE + Policy::PadBytes_ * 2 + HEADER_SIZE) % ALIGNMENT) % ALIGNMENT;
+
+  static constexpr usize BLOCK_SIZE = HEADER_SIZE + Policy::PadBytes_ + OBJECT_SIZE + Policy::PadBytes_
+                                    + INTER_ALIGN_SIZE;
+
+  static constexpr usize PAGE_SIZE = sizeof(GenericObject) + LEFT_ALIGN_SIZE
+                                   + BLOCK_SIZE * Policy::ObjectsPerPage_ - INTER_ALIGN_SIZE;
+
+  /**
+   * @brief Offset of the first block (user pointer) from the start of its page
+   */
+  static constexpr usize FIRST_BLOCK_OFFSET = sizeof(GenericObject) + LEFT_ALIGN_SIZE + HEADER_SIZE + Policy::PadBytes_;
+
+  static_assert(FIRST_BLOCK_OFFSET % alignof(T) == 0 and BLOCK_SIZE % alignof(T) == 0, "Blocks must be aligned for T");
+
+  /**
+   * @brief Pages need a stricter alignment than new[] gives, they are over-allocated and aligned by hand
+   */
+  static constexpr bool OVER_ALIGNED = alignof(T) > alignof(std::max_align_t);
+
+  /*
+   * Creates the allocator and its first page
+   *
+   * Throws an exception if the construction fails. (Memory allocation problem)
+   */
+  TypedObjectAllocator() {
+    statistics.ObjectSize_ = OBJECT_SIZE;
+    statistics.PageSize_ = PAGE_SIZE;
+
+    allocate_page();
+  }
+
+  /*
+   * Destroys the allocator (never throws), objects still in use are not destroyed
+   */
+  ~TypedObjectAllocator() noexcept {
+    while (page_list) {
+      u8* const page = page_list;
+      page_list = as_bytes(as_list(page).Next);
+      free_page(page);
+    }
+  }
+
+  /*
+   * Takes storage for one T off of the free list (simulates new, the object is not constructed)
+   *
+   * Throws an exception if the object can't be allocated. (Memory allocation problem)
+   */
+  T* Allocate(const char* label = nullptr) {
+    if (free_list == nullptr) {
+      allocate_page();
+    }
+
+    u8* const block = free_list;
+    free_list = as_bytes(as_list(block).Next);
+
+    if (Policy::CollectStats_) {
+      statistics.ObjectsInUse_++;
+      statistics.FreeObjects_--;
+
+      statistics.MostObjects_ =
+        statistics.ObjectsInUse_ > statistics.MostObjects_ ? statistics.ObjectsInUse_ : statistics.MostObjects_;
+    }
+
+    // the allocation number lives in the header, so it is counted even when statistics are off
+    if (Policy::CollectStats_ or HEADER_SIZE != 0) {
+      statistics.Allocations_++;
+    }
+
+    setup_allocated_header(block - Policy::PadBytes_ - HEADER_SIZE, label);
+
+    if (Policy::DebugOn_) {
+      memset(block - Policy::PadBytes_, ObjectAllocator::PAD_PATTERN, Policy::PadBytes_);
+      memset(block, ObjectAllocator::ALLOCATED_PATTERN, OBJECT_SIZE);
+      memset(block + OBJECT_SIZE, ObjectAllocator::PAD_PATTERN, Policy::PadBytes_);
+    }
+
+    return reinterpret_cast<T*>(block);
+  }
+
+  /*
+   * Returns storage to the free list (simulates delete, the object is not destroyed)
+   *
+   * Throws an exception if the the object can't be freed. (Invalid object)
+   */
+  void Free(T* const object) {
+    if (object == nullptr) {
+      return;
+    }
+
+    u8* const block = reinterpret_cast<u8*>(object);
+
+    if (Policy::DebugOn_) {
+      validate_boundary(block);
+
+      if (is_in_free_list(block)) {
+        throw OAException(OAException::E_MULTIPLE_FREE, "Block has already been freed");
+      }
+
+      if (not validate_block(block)) {
+        throw OAException(OAException::E_CORRUPTED_BLOCK, "Corrupted Block");
+      }
+    }
+
+    if (Policy::CollectStats_) {
+      statistics.ObjectsInUse_--;
+      statistics.Deallocations_++;
+      statistics.FreeObjects_++;
+    }
+
+    setup_freed_header(block - Policy::PadBytes_ - HEADER_SIZE);
+
+    if (Policy::DebugOn_) {
+      memset(block, ObjectAllocator::FREED_PATTERN, OBJECT_SIZE);
+    }
+
+    as_list(block).Next = reinterpret_cast<GenericObject*>(free_list);
+    free_list = block;
+  }
+
+  /*
+   * Allocates and constructs a T from the given arguments
+   *
+   * Throws whatever Allocate or the constructor throws, the storage is returned if the constructor throws.
+   */
+  template<typename... Args>
+  T* New(Args&&... args) {
+    T* const object = Allocate();
+
+    try {
+      return new (object) T(std::forward<Args>(args)...);
+    } catch (...) {
+      Free(object);
+      throw;
+    }
+  }
+
+  /*
+   * Destroys and frees an object made by New
+   */
+  void Delete(T* const object) {
+    if (object == nullptr) {
+      return;
+    }
+
+    object->~T();
+    Free(object);
+  }
+
+  /*
+   * Calls the callback fn for each block still in use
+   */
+  u32 DumpMemoryInUse(const DUMPCALLBACK callback) const {
+    u32 in_use{0};
+
+    for (const u8* page = page_list; page; page = as_bytes(as_list(page).Next)) {
+      for (usize i = 0; i < Policy::ObjectsPerPage_; i++) {
+        const u8* const block = page + FIRST_BLOCK_OFFSET + i * BLOCK_SIZE;
+
+        if (not is_in_free_list(block)) {
+          in_use++;
+          callback(block, OBJECT_SIZE);
+        }
+      }
+    }
+
+    return in_use;
+  }
+
+  /*
+   * Calls the callback fn for each block that is potentially corrupted
+   */
+  u32 ValidatePages(const VALIDATECALLBACK callback) const {
+    if (not Policy::DebugOn_ or Policy::PadBytes_ == 0) {
+      return 0;
+    }
+
+    u32 invalid_count{0};
+
+    for (const u8* page = page_list; page; page = as_bytes(as_list(page).Next)) {
+      for (usize i = 0; i < Policy::ObjectsPerPage_; i++) {
+        const u8* const block = page + FIRST_BLOCK_OFFSET + i * BLOCK_SIZE;
+
+        if (not validate_block(block)) {
+          callback(block, OBJECT_SIZE);
+          invalid_count++;
+        }
+      }
+    }
+
+    return invalid_count;
+  }
+
+  /**
+   * returns a pointer to the internal free list
+   */
+  const void* GetFreeList() const { return free_list; }
+
+  /**
+   * returns a pointer to the internal page list
+   */
+  const void* GetPageList() const { return page_list; }
+
+  /**
+   * returns the policy as a runtime configuration (for tooling written against the ObjectAllocator)
+   */
+  static OAConfig GetConfig() {
+    OAConfig config(
+      false,
+      Policy::ObjectsPerPage_,
+      Policy::MaxPages_,
+      Policy::DebugOn_,
+      Policy::PadBytes_,
+      OAConfig::HeaderBlockInfo(Policy::HeaderType_, Policy::HeaderAdditional_),
+      static_cast<unsigned>(ALIGNMENT)
+    );
+
+    config.LeftAlignSize_ = static_cast<unsigned>(LEFT_ALIGN_SIZE);
+    config.InterAlignSize_ = static_cast<unsigned>(INTER_ALIGN_SIZE);
+
+    return config;
+  }
+
+  /**
+   * returns the statistics for the allocator, only the sizes and PagesInUse_ are kept when CollectStats_ is off
+   */
+  const OAStats& GetStats() const { return statistics; }
+
+  // Prevent copy construction and assignment
+
+  TypedObjectAllocator(const TypedObjectAllocator&) = delete;            //!< Do not implement!
+  TypedObjectAllocator(TypedObjectAllocator&&) = delete;                 //!< Do not implement!
+  TypedObjectAllocator& operator=(const TypedObjectAllocator&) = delete; //!< Do not implement!
+  TypedObjectAllocator& operator=(TypedObjectAllocator&&) = delete;      //!< Do not implement!
+
+private:
+
+  /**
+   * @brief Allocates a new page, signs it and pushes its blocks onto the free list
+   */
+  TOA_COLD void allocate_page() {
+    if (Policy::MaxPages_ != 0 and statistics.PagesInUse_ >= Policy::MaxPages_) {
+      throw OAException(OAException::E_NO_PAGES, "Out of pages");
+    }
+
+    u8* page;
+
+    try {
+      if (not OVER_ALIGNED) {
+        page = new u8[PAGE_SIZE]{};
+      } else {
+        // the offset back to what new[] returned is kept in the word before the page (alignof(T) > sizeof(usize))
+        u8* const memory = new u8[PAGE_SIZE + alignof(T)]{};
+        const usize offset = alignof(T) - reinterpret_cast<uptr>(memory) % alignof(T);
+
+        page = memory + offset;
+        memcpy(page - sizeof(usize), &offset, sizeof(usize));
+      }
+    } catch (const std::bad_alloc& err) {
+      throw OAException(OAException::E_NO_MEMORY, err.what());
+    }
+
+    statistics.PagesInUse_++;
+
+    if (Policy::CollectStats_) {
+      statistics.FreeObjects_ += Policy::ObjectsPerPage_;
+    }
+
+    as_list(page).Next = reinterpret_cast<GenericObject*>(page_list);
+    page_list = page;
+
+    if (Policy::DebugOn_) {
+      memset(page + sizeof(GenericObject), ObjectAllocator::ALIGN_PATTERN, LEFT_ALIGN_SIZE);
+    }
+
+    // same order as the ObjectAllocator, the first block ends up at the bottom of the free list
+    for (usize i = 0; i < Policy::ObjectsPerPage_; i++) {
+      u8* const block = page + FIRST_BLOCK_OFFSET + BLOCK_SIZE * i;
+
+      memset(block - Policy::PadBytes_, ObjectAllocator::PAD_PATTERN, Policy::PadBytes_);
+      memset(block + OBJECT_SIZE, ObjectAllocator::PAD_PATTERN, Policy::PadBytes_);
+
+      if (Policy::DebugOn_) {
+        memset(block, ObjectAllocator::UNALLOCATED_PATTERN, OBJECT_SIZE);
+
+        if (i + 1 != Policy::ObjectsPerPage_) {
+          memset(block + OBJECT_SIZE + Policy::PadBytes_, ObjectAllocator::ALIGN_PATTERN, INTER_ALIGN_SIZE);
+        }
+      }
+
+      as_list(block).Next = reinterpret_cast<GenericObject*>(free_list);
+      free_list = block;
+    }
+  }
+
+  /**
+   * @brief Frees a page (the external headers of its blocks go with the pool)
+   */
+  static void free_page(u8* const page) {
+    if (OVER_ALIGNED) {
+      usize offset;
+      memcpy(&offset, page - sizeof(usize), sizeof(usize));
+      delete[] (page - offset);
+      return;
+    }
+
+    delete[] page;
+  }
+
+  /**
+   * @brief Throws E_BAD_BOUNDARY unless the block is the start of a block on one of the pages, O(pages)
+   */
+  void validate_boundary(const u8* const block) const {
+    for (const u8* page = page_list; page; page = as_bytes(as_list(page).Next)) {
+      if (block < page or block >= page + PAGE_SIZE) {
+        continue;
+      }
+
+      const u8* const first = page + FIRST_BLOCK_OFFSET;
+
+      if (block < first or static_cast<usize>(block - first) % BLOCK_SIZE != 0) {
+        throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry");
+      }
+
+      return;
+    }
+
+    throw OAException(OAException::E_BAD_BOUNDARY, "Invalid Boundry, not on any pages");
+  }
+
+  /**
+   * @brief Checks if the given block is free, O(1) with headers otherwise a walk of the free list
+   */
+  bool is_in_free_list(const u8* const block) const {
+    const u8* const header = block - Policy::PadBytes_ - HEADER_SIZE;
+
+    switch (Policy::HeaderType_) {
+      case OAConfig::hbBasic: return (header[sizeof(u32)] & 0x1) == 0;
+      case OAConfig::hbExtended: return (header[Policy::HeaderAdditional_ + sizeof(u16) + sizeof(u32)] & 0x1) == 0;
+      case OAConfig::hbExternal: return *reinterpret_cast<const MemBlockInfo* const*>(header) == nullptr;
+      case OAConfig::hbNone:
+      default: break;
+    }
+
+    for (const u8* free = free_list; free; free = as_bytes(as_list(free).Next)) {
+      if (free == block) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * @brief Validates that the pad bytes around a block are intact
+   */
+  static bool validate_block(const u8* const block) {
+    for (usize i = 0; i < Policy::PadBytes_; i++) {
+      if (block[-1 - static_cast<iptr>(i)] != ObjectAllocator::PAD_PATTERN
+          or block[OBJECT_SIZE + i] != ObjectAllocator::PAD_PATTERN) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Book keeping for the header of a block being allocated
+   */
+  void setup_allocated_header(u8* const header, const char* const label) {
+    switch (Policy::HeaderType_) {
+      case OAConfig::hbBasic:
+        {
+          memcpy(header, &statistics.Allocations_, sizeof(u32));
+          header[sizeof(u32)] |= 0x1;
+          return;
+        }
+      case OAConfig::hbExtended:
+        {
+          u8* pos = header;
+
+          memset(pos, 0, Policy::HeaderAdditional_);
+          pos += Policy::HeaderAdditional_;
+
+          u16 use_count;
+          memcpy(&use_count, pos, sizeof(u16));
+          use_count++;
+          memcpy(pos, &use_count, sizeof(u16));
+          pos += sizeof(u16);
+
+          memcpy(pos, &statistics.Allocations_, sizeof(u32));
+          pos += sizeof(u32);
+
+          *pos |= 0x1;
+          return;
+        }
+      case OAConfig::hbExternal:
+        {
+          *reinterpret_cast<MemBlockInfo**>(header) = block_infos.Acquire(label, statistics.Allocations_);
+          return;
+        }
+      case OAConfig::hbNone:
+      default: break;
+    }
+  }
+
+  /**
+   * @brief Book keeping for the header of a block being freed
+   */
+  void setup_freed_header(u8* const header) {
+    switch (Policy::HeaderType_) {
+      case OAConfig::hbBasic:
+        {
+          memset(header, 0, sizeof(u32));
+          header[sizeof(u32)] &= static_cast<u8>(~0x1);
+          return;
+        }
+      case OAConfig::hbExtended:
+        {
+          u8* const pos = header + Policy::HeaderAdditional_ + sizeof(u16);
+
+          memset(pos, 0, sizeof(u32));
+          pos[sizeof(u32)] &= static_cast<u8>(~0x1);
+          return;
+        }
+      case OAConfig::hbExternal:
+        {
+          MemBlockInfo*& info = *reinterpret_cast<MemBlockInfo**>(header);
+
+          block_infos.Release(info);
+          info = nullptr;
+          return;
+        }
+      case OAConfig::hbNone:
+      default: break;
+    }
+  }
+
+  /**
+   * @brief Converts bytes to a generic object reference
+   */
+  static GenericObject& as_list(u8* const bytes) { return *reinterpret_cast<GenericObject*>(bytes); }
+
+  /**
+   * @brief Converts bytes to a generic object reference
+   */
+  static const GenericObject& as_list(const u8* const bytes) { return *reinterpret_cast<const GenericObject*>(bytes); }
+
+  /**
+   * @brief Converts a generic object to its bytes repr
+   */
+  static u8* as_bytes(GenericObject* const object) { return reinterpret_cast<u8*>(object); }
+
+  /**
+   * @brief Converts a generic object to its bytes repr
+   */
+  static const u8* as_bytes(const GenericObject* const object) { return reinterpret_cast<const u8*>(object); }
+
+  /**
+   * @brief Start of the page list
+   */
+  u8* page_list{nullptr};
+
+  /**
+   * @brief Start of the free block list
+   */
+  u8* free_list{nullptr};
+
+  /**
+   * @brief Statistic Tracker
+   */
+  OAStats statistics{};
+
+  /**
+   * @brief Interned labels and records of the external headers (hbExternal), a page worth of records at a time
+   */
+  MemBlockInfoPool block_infos{Policy::ObjectsPerPage_};
+};
+
+// out of class definitions for the constants (they may be odr-used before C++17)
+
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr OAConfig::HBLOCK_TYPE OAPolicy<H, P, A, D, S, O, M, X>::HeaderType_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr unsigned OAPolicy<H, P, A, D, S, O, M, X>::HeaderAdditional_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr unsigned OAPolicy<H, P, A, D, S, O, M, X>::PadBytes_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr unsigned OAPolicy<H, P, A, D, S, O, M, X>::Alignment_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr bool OAPolicy<H, P, A, D, S, O, M, X>::DebugOn_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr bool OAPolicy<H, P, A, D, S, O, M, X>::CollectStats_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr unsigned OAPolicy<H, P, A, D, S, O, M, X>::ObjectsPerPage_;
+template<OAConfig::HBLOCK_TYPE H, unsigned P, unsigned A, bool D, bool S, unsigned O, unsigned M, unsigned X>
+constexpr unsigned OAPolicy<H, P, A, D, S, O, M, X>::MaxPages_;
+
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::OBJECT_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::HEADER_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::ALIGNMENT;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::LEFT_ALIGN_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::INTER_ALIGN_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::BLOCK_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::PAGE_SIZE;
+template<typename T, typename Policy>
+constexpr usize TypedObjectAllocator<T, Policy>::FIRST_BLOCK_OFFSET;
+template<typename T, typename Policy>
+constexpr bool TypedObjectAllocator<T, Policy>::OVER_ALIGNED;
+
+#undef TOA_COLD
+
+#endif
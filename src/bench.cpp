@@ -0,0 +1,444 @@
+#include "ObjectAllocator.h"
+#include "PRNG.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  #include <x86intrin.h>
+  #define OA_BENCH_TSC 1
+#else
+  #define OA_BENCH_TSC 0
+#endif
+
+// Allocation patterns seen in real programs, each one run on an ObjectAllocator and on UseCPPMemManager_ (new/delete)
+//
+// Throughput is the best of ROUNDS untimed runs. One more run then times every Allocate / Free call on its own for
+// the latency percentiles (clock overhead taken out) and watches the pages in use for the peak. Every run replays
+// the same PRNG seed on a fresh allocator, so results only move with the allocator.
+namespace {
+  struct Student {
+    int Age;
+    float GPA;
+    long long Year;
+    long long ID;
+  };
+
+  constexpr unsigned OBJECTS_PER_PAGE = 1024;
+  constexpr unsigned OPERATIONS = 1u << 21; // Allocate + Free calls in one run of a scenario
+  constexpr unsigned ROUNDS = 5;
+  constexpr unsigned SEED = 8;
+
+  u64 ticks() {
+#if OA_BENCH_TSC
+    return __rdtsc();
+#else
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+#endif
+  }
+
+  /**
+   * @brief Length of a tick, and the smallest interval two back to back reads give (taken out of every latency)
+   */
+  struct Clock {
+    double ns_per_tick;
+    u64 overhead;
+  };
+
+  Clock calibrate() {
+    Clock clock{1.0, ~u64{0}};
+
+#if OA_BENCH_TSC
+    const auto start = std::chrono::steady_clock::now();
+    const u64 first = ticks();
+
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50)) {
+    }
+
+    const u64 last = ticks();
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    clock.ns_per_tick = ns / static_cast<double>(last - first);
+#endif
+
+    for (unsigned i = 0; i < 10000; i++) {
+      const u64 start = ticks();
+      clock.overhead = std::min(clock.overhead, ticks() - start);
+    }
+
+    return clock;
+  }
+
+  /**
+   * @brief What a timed run collects on one thread
+   */
+  struct Samples {
+    std::vector<u32> latencies; //!< Ticks per call
+    unsigned peak_pages{0};     //!< Most pages in use seen after an Allocate
+  };
+
+  /**
+   * @brief The allocator as scenarios see it, counting calls (and timing each one when Timed)
+   */
+  template<bool Timed>
+  class Heap {
+  public:
+    Heap(ObjectAllocator& oa, Samples* samples, const u64 overhead): oa(oa), samples(samples), overhead(overhead) {}
+
+    void* allocate() {
+      calls++;
+
+      if (not Timed) {
+        return oa.Allocate();
+      }
+
+      const u64 start = ticks();
+      void* const block = oa.Allocate();
+      record(start);
+
+      samples->peak_pages = std::max(samples->peak_pages, oa.GetStats().PagesInUse_);
+      return block;
+    }
+
+    void free(void* const block) {
+      calls++;
+
+      if (not Timed) {
+        oa.Free(block);
+        return;
+      }
+
+      const u64 start = ticks();
+      oa.Free(block);
+      record(start);
+    }
+
+    /**
+     * @brief Gives empty pages back between phases (not a counted call)
+     */
+    void release() { oa.FreeEmptyPages(); }
+
+    /**
+     * @brief Makes the calling thread the one allocating (RemoteFree_)
+     */
+    void own() { oa.SetOwnerThread(); }
+
+    u64 calls{0};
+
+  private:
+    void record(const u64 start) {
+      const u64 elapsed = ticks() - start;
+      const u64 latency = elapsed > overhead ? elapsed - overhead : 0;
+      samples->latencies.push_back(static_cast<u32>(std::min<u64>(latency, ~u32{0})));
+    }
+
+    ObjectAllocator& oa;
+    Samples* samples;
+    u64 overhead;
+  };
+
+  // A stack growing and shrinking by a few objects at a time around a steady base (temporaries, recursion)
+  struct LifoChurn {
+    static constexpr const char* NAME = "LIFO churn";
+    static constexpr bool THREADED = false;
+    static constexpr unsigned BASE = 4096;
+
+    template<bool Timed>
+    void operator()(Heap<Timed>& heap, Heap<Timed>&) const {
+      std::vector<void*> stack;
+      stack.reserve(BASE + 32);
+
+      for (unsigned i = 0; i < BASE; i++) {
+        stack.push_back(heap.allocate());
+      }
+
+      while (heap.calls < OPERATIONS - BASE) {
+        const unsigned n = static_cast<unsigned>(Digipen::Utils::Random(1, 32));
+
+        for (unsigned i = 0; i < n; i++) {
+          stack.push_back(heap.allocate());
+        }
+
+        for (unsigned i = 0; i < n; i++) {
+          heap.free(stack.back());
+          stack.pop_back();
+        }
+      }
+
+      for (void* const block : stack) {
+        heap.free(block);
+      }
+    }
+  };
+
+  // Messages queued and retired oldest first, DEPTH of them in flight
+  struct FifoQueue {
+    static constexpr const char* NAME = "FIFO queue";
+    static constexpr bool THREADED = false;
+    static constexpr unsigned DEPTH = 8192;
+
+    template<bool Timed>
+    void operator()(Heap<Timed>& heap, Heap<Timed>&) const {
+      std::vector<void*> ring(DEPTH);
+
+      for (void*& block : ring) {
+        block = heap.allocate();
+      }
+
+      for (unsigned head = 0; heap.calls < OPERATIONS - DEPTH; head = (head + 1) % DEPTH) {
+        heap.free(ring[head]);
+        ring[head] = heap.allocate();
+      }
+
+      for (void* const block : ring) {
+        heap.free(block);
+      }
+    }
+  };
+
+  // One object allocated per step, each living a log-uniform number of steps: mostly short, with a long tail
+  struct RandomLifetimes {
+    static constexpr const char* NAME = "Random lifetimes";
+    static constexpr bool THREADED = false;
+    static constexpr int LONGEST = 16; // lifetimes up to 2^LONGEST steps
+
+    struct Due {
+      u64 step;
+      void* block;
+
+      bool operator>(const Due& other) const { return step > other.step; }
+    };
+
+    template<bool Timed>
+    void operator()(Heap<Timed>& heap, Heap<Timed>&) const {
+      std::vector<Due> storage;
+      storage.reserve(OPERATIONS / 2);
+
+      std::priority_queue<Due, std::vector<Due>, std::greater<Due>> pending(std::greater<Due>(), std::move(storage));
+
+      for (u64 step = 0; heap.calls < OPERATIONS - pending.size(); step++) {
+        const int scale = Digipen::Utils::Random(0, LONGEST);
+        const u64 lifetime = 1 + static_cast<u64>(Digipen::Utils::Random(0, (1 << scale) - 1));
+
+        pending.push(Due{step + lifetime, heap.allocate()});
+
+        while (pending.top().step <= step) {
+          heap.free(pending.top().block);
+          pending.pop();
+        }
+      }
+
+      while (not pending.empty()) {
+        heap.free(pending.top().block);
+        pending.pop();
+      }
+    }
+  };
+
+  // Load spikes: BURST objects at once, all freed in random order, then the empty pages given back
+  struct BurstDrain {
+    static constexpr const char* NAME = "Burst / drain";
+    static constexpr bool THREADED = false;
+    static constexpr unsigned BURST = 32768;
+
+    template<bool Timed>
+    void operator()(Heap<Timed>& heap, Heap<Timed>&) const {
+      std::vector<void*> blocks(BURST);
+      std::vector<unsigned> order(BURST);
+
+      for (unsigned i = 0; i < BURST; i++) {
+        order[i] = i;
+      }
+
+      while (heap.calls < OPERATIONS) {
+        for (void*& block : blocks) {
+          block = heap.allocate();
+        }
+
+        for (unsigned i = 0; i < BURST; i++) {
+          const int r = Digipen::Utils::Random(static_cast<int>(i), static_cast<int>(BURST) - 1);
+          std::swap(order[i], order[static_cast<unsigned>(r)]);
+          heap.free(blocks[order[i]]);
+        }
+
+        heap.release();
+      }
+    }
+  };
+
+  // One thread allocates messages, another frees them once read (RemoteFree_ queues the frees back to the owner)
+  struct ProducerConsumer {
+    static constexpr const char* NAME = "Producer / consumer";
+    static constexpr bool THREADED = true;
+    static constexpr unsigned CAPACITY = 1024; // messages in flight, a power of two
+
+    // waiting threads yield, with fewer cores than threads a spin would burn the other side's time slice
+
+    template<bool Timed>
+    void operator()(Heap<Timed>& producer, Heap<Timed>& consumer) const {
+      std::vector<void*> ring(CAPACITY);
+      std::atomic<unsigned> head{0};
+      std::atomic<unsigned> tail{0};
+
+      std::thread producing([&] {
+        producer.own();
+
+        for (unsigned sent = 0; sent < OPERATIONS / 2; sent++) {
+          while (sent - head.load(std::memory_order_acquire) == CAPACITY) {
+            std::this_thread::yield();
+          }
+
+          ring[sent % CAPACITY] = producer.allocate();
+          tail.store(sent + 1, std::memory_order_release);
+        }
+      });
+
+      std::thread consuming([&] {
+        for (unsigned received = 0; received < OPERATIONS / 2; received++) {
+          while (tail.load(std::memory_order_acquire) == received) {
+            std::this_thread::yield();
+          }
+
+          consumer.free(ring[received % CAPACITY]);
+          head.store(received + 1, std::memory_order_release);
+        }
+      });
+
+      producing.join();
+      consuming.join();
+    }
+  };
+
+  /**
+   * @brief One scenario on one allocator
+   */
+  struct Result {
+    double ops_per_second;
+    double p50;
+    double p99;
+    double p999;
+    unsigned peak_pages;
+  };
+
+  double percentile(std::vector<u32>& latencies, const double fraction, const Clock& clock) {
+    if (latencies.empty()) {
+      return 0;
+    }
+
+    const auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(fraction * static_cast<double>(latencies.size() - 1));
+    std::nth_element(latencies.begin(), nth, latencies.end());
+
+    return *nth * clock.ns_per_tick;
+  }
+
+  template<typename Scenario>
+  Result measure(const OAConfig& config, const Clock& clock) {
+    Result result{0, 0, 0, 0, 0};
+
+    for (unsigned r = 0; r < ROUNDS; r++) {
+      Digipen::Utils::srand(SEED, SEED);
+
+      ObjectAllocator oa(sizeof(Student), config);
+      Heap<false> first(oa, nullptr, 0);
+      Heap<false> second(oa, nullptr, 0);
+
+      const auto start = std::chrono::steady_clock::now();
+      Scenario{}(first, second);
+      const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      result.ops_per_second = std::max(result.ops_per_second, static_cast<double>(first.calls + second.calls) / seconds);
+    }
+
+    Digipen::Utils::srand(SEED, SEED);
+
+    Samples first_samples;
+    Samples second_samples;
+    first_samples.latencies.reserve(OPERATIONS + OPERATIONS / 8);
+    second_samples.latencies.reserve(OPERATIONS / 2);
+
+    {
+      ObjectAllocator oa(sizeof(Student), config);
+      Heap<true> first(oa, &first_samples, clock.overhead);
+      Heap<true> second(oa, &second_samples, clock.overhead);
+
+      Scenario{}(first, second);
+    }
+
+    std::vector<u32>& latencies = first_samples.latencies;
+    latencies.insert(latencies.end(), second_samples.latencies.begin(), second_samples.latencies.end());
+
+    result.p50 = percentile(latencies, 0.5, clock);
+    result.p99 = percentile(latencies, 0.99, clock);
+    result.p999 = percentile(latencies, 0.999, clock);
+    result.peak_pages = first_samples.peak_pages;
+
+    return result;
+  }
+
+  void print(const char* scenario, const char* allocator, const Result& result) {
+    char pages[16] = "-";
+
+    if (result.peak_pages != 0) {
+      std::snprintf(pages, sizeof(pages), "%u", result.peak_pages);
+    }
+
+    std::printf(
+      "%-20s %-16s %9.2f %8.1f %8.1f %8.1f %10s\n",
+      scenario,
+      allocator,
+      result.ops_per_second / 1e6,
+      result.p50,
+      result.p99,
+      result.p999,
+      pages
+    );
+  }
+
+  template<typename Scenario>
+  void run(const char* filter, const Clock& clock) {
+    if (filter != nullptr and std::strstr(Scenario::NAME, filter) == nullptr) {
+      return;
+    }
+
+    OAConfig pooled(false, OBJECTS_PER_PAGE, 0);
+    pooled.RemoteFree_ = Scenario::THREADED;
+
+    print(Scenario::NAME, "ObjectAllocator", measure<Scenario>(pooled, clock));
+    print(Scenario::NAME, "new/delete", measure<Scenario>(OAConfig(true, OBJECTS_PER_PAGE, 0), clock));
+  }
+}
+
+// oa_bench [scenario]: runs every scenario, or only those whose name contains the argument
+int main(int argc, char** argv) {
+  const char* const filter = argc > 1 ? argv[1] : nullptr;
+  const Clock clock = calibrate();
+
+  std::printf(
+    "%u calls per run on %zu byte objects, %u objects per page, best of %u rounds (latency: %s, %.2f ns/tick)\n\n",
+    OPERATIONS,
+    sizeof(Student),
+    OBJECTS_PER_PAGE,
+    ROUNDS,
+    OA_BENCH_TSC ? "rdtsc" : "steady_clock",
+    clock.ns_per_tick
+  );
+
+  std::printf(
+    "%-20s %-16s %9s %8s %8s %8s %10s\n", "Scenario", "Allocator", "Mops/s", "p50 ns", "p99 ns", "p999 ns", "Peak pages"
+  );
+
+  run<LifoChurn>(filter, clock);
+  run<FifoQueue>(filter, clock);
+  run<RandomLifetimes>(filter, clock);
+  run<BurstDrain>(filter, clock);
+  run<ProducerConsumer>(filter, clock);
+
+  return 0;
+}
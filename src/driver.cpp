@@ -14,8 +14,21 @@ int SHOW_EXCEPTIONS = 0; // Show student exceptions in all tests
 int EXTRA_CREDIT = 1; // Run extra credit tests (Alignment, FreeEmptyPages)
 
 #include "ObjectAllocator.h"
+#include "ThreadCachedAllocator.h"
+#include "TypedObjectAllocator.h"
+#include "SizeClassAllocator.h"
+#include "PoolAllocator.h"
+#include "ShardedAllocator.h"
 #include "PRNG.h"
 
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 struct Student {
   int Age;
   float GPA;
@@ -1560,6 +1573,13 @@ void PrintConfig(const ObjectAllocator* oa) {
            OAConfig::hbExternal) cout << "External";
   cout << ", Header size = " << oa->GetConfig().HBlockInfo_.size_;
   cout << endl;
+  if (oa->GetConfig().CacheLineLayout_) {
+    const OAConfig& config = oa->GetConfig();
+    const size_t used = sizeof(void*) + config.ObjectsPerPage_ * (config.
+      HBlockInfo_.size_ + 2 * config.PadBytes_ + oa->GetStats().ObjectSize_);
+    cout << "CacheLineLayout = on, Wasted bytes = " << config.InterAlignSize_ <<
+      " per block, " << oa->GetStats().PageSize_ - used << " per page" << endl;
+  }
 }
 
 void DumpPages(const ObjectAllocator* nm, unsigned width) {
@@ -1851,124 +1871,1685 @@ void Test1(void) {
   delete oa;
 }
 
-int main(int argc, char** argv) {
-  #ifdef _MSC_VER
-    _CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
-    _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
-    _CrtSetReportFile(_CRT_WARN, _CRTDBG_FILE_STDERR);
-  #endif
+// the allocator most tests below start from: debug checks on, 2 pad bytes
+OAConfig DebugConfig(unsigned objects, unsigned pages,
+  const OAConfig::HeaderBlockInfo& header = OAConfig::HeaderBlockInfo(
+  OAConfig::hbBasic), unsigned alignment = 0) {
+  return OAConfig(false, objects, pages, true, 2, header, alignment);
+}
 
-  int test = 0;
+void ConstructionFailed(const OAException& e, const char* test) {
+  if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+  else cout << "Exception thrown during construction in " << test << "." <<
+    endl;
+}
 
-  if (argc > 1) test = std::atoi(argv[1]);
-  if (argc > 2) SHOWADDRESS1 = std::atoi(argv[2]);
-  if (argc > 3) SHOWADDRESS2 = std::atoi(argv[3]);
-  if (argc > 4) SHOWREAL = std::atoi(argv[4]);
-  if (argc > 5) SHOW_EXCEPTIONS = std::atoi(argv[5]);
-  if (argc > 6) EXTRA_CREDIT = std::atoi(argv[6]);
+void PrintCounts(const OAStats& stats) {
+  cout << "Objects in use: " << stats.ObjectsInUse_;
+  cout << ", Allocs: " << stats.Allocations_;
+  cout << ", Frees: " << stats.Deallocations_ << endl;
+}
 
-  switch (test) {
-    case 1: cout << "============================== Students..." << endl;
-      DoStudents(0, false);
-      cout << endl;
-      break;
-    case 2: cout << "============================== Students..." << endl;
-      DoStudents(0, true);
-      cout << endl;
-      break;
-    case 3: cout << "============================== Employees..." << endl;
-      DoEmployees();
-      cout << endl;
-      break;
-    case 4: cout << "============================== Test padding..." << endl;
-      TestPadding(6);
-      cout << endl;
-      break;
-    case 5: cout << "============================== Test padding..." << endl;
-      TestPadding(10);
-      cout << endl;
-      break;
-    case 6: cout << "============================== Test basic header blocks..."
-            << endl;
-      TestBasicHeaderBlocks();
-      cout << endl;
-      break;
-    case 7: cout <<
-            "============================== Test extended header blocks(1)..."
-            << endl;
-      TestExtendedHeaderBlocks(1);
-      cout << endl;
-      break;
-    case 8: cout <<
-            "============================== Test external header blocks..." <<
-            endl;
-      TestExternalHeaderBlocks();
-      cout << endl;
-      break;
-    case 9: cout << "============================== Test corruption..." << endl;
-      TestCorruption();
-      cout << endl;
-      break;
-    case 10: cout << "============================== Test using new/delete..."
-             << endl;
-      DisableOA();
-      cout << endl;
-      break;
-    case 11: cout << "============================== Test leak..." << endl;
-      TestLeak();
-      cout << endl;
-      break;
-    case 12: cout << "============================== Test validate..." << endl;
-      TestValidate();
-      cout << endl;
-      break;
-    case 13: cout <<
-             "============================== Test free checking basic (stress)..."
-             << endl;
-      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
-      cout << endl;
-      break;
-    case 14: cout <<
-             "============================== Test free checking extended (stress)..."
-             << endl;
-      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbExtended, 1));
-      cout << endl;
-      break;
-    case 15: cout <<
-             "============================== Test free checking external (stress)..."
-             << endl;
-      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
-      cout << endl;
-      break;
-    case 16: cout <<
-             "============================== Test stress using new/delete..." <<
-             endl;
-      Stress(true);
-      cout << endl;
-      break;
-    case 17: cout <<
-             "============================== Test stress using allocator..." <<
-             endl;
-      Stress(false);
-      cout << endl;
-      break;
-    case 18: cout << "============================== Test alignment..." << endl;
-      TestAlignment();
-      cout << endl;
-      break;
-    case 19: cout << "============================== Test free empty pages 1..."
-             << endl;
-      TestFreeEmptyPages1();
-      cout << endl;
-      break;
-    case 20: cout << "============================== Test free empty pages 2..."
-             << endl;
-      TestFreeEmptyPages2();
-      cout << endl;
-      break;
-    case 21: cout << "============================== Test free empty pages 3..."
-             << endl;
-      TestFreeEmptyPages4();
+void TestThreadCache(void) {
+  ThreadCachedAllocator* tca;
+  const unsigned threads = 4;
+  const unsigned count = 500;
+
+  try {
+    OAConfig config = DebugConfig(64, 0);
+    tca = new ThreadCachedAllocator(sizeof(Student), config, 16);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestThreadCache");
+
+    return;
+  }
+
+  PrintCounts(tca->GetStats());
+
+  // each worker keeps 100 objects alive, hands the rest back and exits
+  // (which flushes its magazine)
+  std::thread workers[threads];
+  void* kept[threads][100];
+
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t] = std::thread([tca, t, &kept]() {
+      void* ptrs[count];
+      for (unsigned i = 0; i < count; i++) ptrs[i] = tca->Allocate();
+      for (unsigned i = 100; i < count; i++) tca->Free(ptrs[i]);
+      for (unsigned i = 0; i < 100; i++) kept[t][i] = ptrs[i];
+    });
+  }
+
+  for (unsigned t = 0; t < threads; t++) workers[t].join();
+
+  PrintCounts(tca->GetStats());
+  cout << "Most objects in use: " << (tca->GetStats().MostObjects_ >=
+    threads * 100 ? "ok" : "too low") << endl;
+
+  try {
+    for (unsigned t = 0; t < threads; t++)
+      for (unsigned i = 0; i < 100; i++) tca->Free(kept[t][i]);
+    tca->Flush();
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestThreadCache." << endl;
+  }
+
+  PrintCounts(tca->GetStats());
+
+  delete tca;
+}
+
+void TestConcurrentFreeList(void) {
+  ObjectAllocator* oa;
+  const unsigned threads = 4;
+  const unsigned count = 500;
+
+  try {
+    OAConfig config = DebugConfig(64, 0);
+    config.ConcurrentFreeList_ = true;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestConcurrentFreeList");
+
+    return;
+  }
+
+  // no mutex anywhere, every worker hammers the same allocator
+  std::thread workers[threads];
+  void* kept[threads][100];
+
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t] = std::thread([oa, t, &kept]() {
+      void* ptrs[count];
+      for (unsigned i = 0; i < count; i++) ptrs[i] = oa->Allocate();
+      for (unsigned i = 100; i < count; i++) oa->Free(ptrs[i]);
+      for (unsigned i = 0; i < 100; i++) kept[t][i] = ptrs[i];
+    });
+  }
+
+  for (unsigned t = 0; t < threads; t++) workers[t].join();
+
+  PrintCounts(oa->GetStats());
+  cout << "Leaks dumped: " << oa->DumpMemoryInUse(DumpCallback2) << endl;
+
+  try {
+    oa->Free(kept[0][0]);
+    oa->Free(kept[0][0]);
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_MULTIPLE_FREE)
+      cout << "****** Freeing object twice. ******" << endl;
+  }
+
+  for (unsigned t = 0; t < threads; t++)
+    for (unsigned i = t == 0 ? 1 : 0; i < 100; i++) oa->Free(kept[t][i]);
+
+  PrintCounts(oa->GetStats());
+  oa->FreeEmptyPages();
+  PrintCounts(oa);
+
+  delete oa;
+}
+
+void TestBatch(void) {
+  ObjectAllocator* oa;
+  void* ptrs[10];
+
+  try {
+    OAConfig config = DebugConfig(4, 3);
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestBatch");
+
+    return;
+  }
+
+  try {
+    PrintConfig(oa);
+    PrintCounts(oa);
+
+    oa->AllocateBatch(ptrs, 10);
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    // every other one, in reverse, they go back grouped by page
+    void* evens[5];
+    for (unsigned i = 0; i < 5; i++) evens[i] = ptrs[8 - i * 2];
+    oa->FreeBatch(evens, 5);
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestBatch." << endl;
+
+    delete oa;
+    return;
+  }
+
+  try {
+    void* twice[2] = {ptrs[1], ptrs[1]};
+    oa->FreeBatch(twice, 2);
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_MULTIPLE_FREE)
+      cout << "****** Freeing object twice. ******" << endl;
+  }
+
+  try {
+    void* more[8];
+    oa->AllocateBatch(more, 8);
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_NO_PAGES)
+      cout << "****** Out of pages. ******" << endl;
+  }
+  PrintCounts(oa);
+
+  void* odds[5];
+  for (unsigned i = 0; i < 5; i++) odds[i] = ptrs[i * 2 + 1];
+  oa->FreeBatch(odds, 5);
+  PrintCounts(oa);
+
+  delete oa;
+}
+
+void TestMappedPages(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbExtended, 2);
+    OAConfig config = DebugConfig(4, 2, header, 8);
+    config.PageBackend_ = OAConfig::pbMapped;
+    oa = new ObjectAllocator(sizeof(Student), config);
+
+    PrintConfig(oa);
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    void* ptrs[8];
+    for (unsigned i = 0; i < 8; i++) ptrs[i] = oa->Allocate();
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    // every page starts on (at least) an OS page boundary
+    const unsigned char* page = static_cast<const unsigned char*>(oa->
+      GetPageList());
+    bool aligned = true;
+    for (; page; page = reinterpret_cast<const unsigned char*>(
+      reinterpret_cast<const GenericObject*>(page)->Next))
+      aligned = aligned && reinterpret_cast<size_t>(page) % 4096 == 0;
+    cout << "Pages aligned: " << (aligned ? "yes" : "no") << endl;
+
+    for (unsigned i = 0; i < 8; i++) oa->Free(ptrs[i]);
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintCounts(oa);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestMappedPages." << endl;
+
+    return;
+  }
+
+  delete oa;
+}
+
+void TestLazyPages(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+    OAConfig config = DebugConfig(4, 2, header, 8);
+    config.LazyPageInit_ = true;
+    // heap pages are not zeroed, mapped ones show what was never touched
+    config.PageBackend_ = OAConfig::pbMapped;
+    oa = new ObjectAllocator(sizeof(Student), config);
+
+    // nothing but the page header is touched until blocks are handed out
+    PrintConfig(oa);
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    void* p1 = oa->Allocate();
+    void* p2 = oa->Allocate();
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    // recycled blocks are handed out before the bump pointer moves on
+    oa->Free(p1);
+    p1 = oa->Allocate();
+    void* p3 = oa->Allocate();
+    PrintCounts(oa);
+    DumpPages(oa, 32);
+
+    cout << "Corrupted blocks: " << oa->ValidatePages(ValidateCallback) <<
+      endl;
+    cout << "\nChecking for leaks...\n";
+    CheckAndDumpLeaks(oa);
+
+    oa->Free(p1);
+    oa->Free(p2);
+    oa->Free(p3);
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintCounts(oa);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestLazyPages." << endl;
+
+    return;
+  }
+
+  delete oa;
+}
+
+struct Point {
+  Point(int x, int y) : X(x), Y(y) {}
+  long long X;
+  long long Y;
+};
+
+// same pages byte for byte, except for free list links inside of free blocks
+template<typename Typed>
+bool SameLayout(const ObjectAllocator* oa, const Typed& typed) {
+  const unsigned char* page = static_cast<const unsigned char*>(oa->
+    GetPageList());
+  const unsigned char* other = static_cast<const unsigned char*>(typed.
+    GetPageList());
+  const size_t page_size = oa->GetStats().PageSize_;
+  const size_t first = Typed::FIRST_BLOCK_OFFSET;
+
+  while (page && other) {
+    for (size_t i = sizeof(void*); i < page_size; i++) {
+      bool link = false;
+
+      if (i >= first && (i - first) % Typed::BLOCK_SIZE < sizeof(void*)) {
+        const unsigned char* block = page + i - (i - first) % Typed::BLOCK_SIZE;
+        const GenericObject* free = static_cast<const GenericObject*>(oa->
+          GetFreeList());
+
+        for (; free && !link; free = free->Next) link = free ==
+          reinterpret_cast<const GenericObject*>(block);
+      }
+
+      if (!link && page[i] != other[i]) return false;
+    }
+
+    page = *reinterpret_cast<const unsigned char* const*>(page);
+    other = *reinterpret_cast<const unsigned char* const*>(other);
+  }
+
+  return page == other;
+}
+
+void TestTypedAllocator(void) {
+  typedef OAPolicy<OAConfig::hbBasic, 2, 8, true, true, 4, 3> DebugPolicy;
+  typedef TypedObjectAllocator<Student, DebugPolicy> DebugAllocator;
+  ObjectAllocator* oa = 0;
+  DebugAllocator* typed = 0;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+    OAConfig config = DebugConfig(4, 3, header, 8);
+
+    oa = new ObjectAllocator(sizeof(Student), config);
+    typed = new DebugAllocator;
+
+    cout << "Block size = " << DebugAllocator::BLOCK_SIZE;
+    cout << ", Page size = " << DebugAllocator::PAGE_SIZE;
+    cout << ", LeftAlign = " << DebugAllocator::LEFT_ALIGN_SIZE;
+    cout << ", InterAlign = " << DebugAllocator::INTER_ALIGN_SIZE << endl;
+
+    void* a[6];
+    Student* b[6];
+
+    for (int i = 0; i < 6; i++) {
+      a[i] = oa->Allocate();
+      b[i] = typed->Allocate();
+    }
+
+    oa->Free(a[4]);
+    typed->Free(b[4]);
+    oa->Free(a[1]);
+    typed->Free(b[1]);
+    a[1] = oa->Allocate();
+    b[1] = typed->Allocate();
+
+    cout << "Same layout: " << (SameLayout(oa, *typed) ? "yes" : "no") <<
+      endl;
+    PrintCounts(typed->GetStats());
+    cout << "In use: " << typed->DumpMemoryInUse(DumpCallback2) << endl;
+
+    try {
+      typed->Free(b[4]);
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_MULTIPLE_FREE) cout <<
+        "Double free detected" << endl;
+    }
+
+    try {
+      typed->Free(reinterpret_cast<Student*>(reinterpret_cast<char*>(b[0]) +
+        4));
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_BAD_BOUNDARY) cout <<
+        "Bad boundary detected" << endl;
+    }
+
+    reinterpret_cast<char*>(b[2])[sizeof(Student)] = 0;
+    cout << "Corrupted blocks: " << typed->ValidatePages(DumpCallback2) <<
+      endl;
+
+    try {
+      typed->Free(b[2]);
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_CORRUPTED_BLOCK) cout <<
+        "Corruption detected" << endl;
+    }
+
+    try {
+      for (int i = 0; i < 12; i++) typed->Allocate();
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_NO_PAGES) cout << "Out of pages" << endl;
+    }
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestTypedAllocator." << endl;
+  }
+
+  delete oa;
+  delete typed;
+
+  // release policy: no headers, checks or counters
+  TypedObjectAllocator<Point, OAPolicy<OAConfig::hbNone, 0, 0, false, false,
+    64, 0> > points;
+  Point* p[100];
+
+  for (int i = 0; i < 100; i++) p[i] = points.New(i, -i);
+
+  long long sum = 0;
+  for (int i = 0; i < 100; i++) sum += p[i]->X - p[i]->Y;
+  for (int i = 0; i < 100; i++) points.Delete(p[i]);
+
+  cout << "Sum = " << sum << ", Pages in use: " << points.GetStats().
+    PagesInUse_ << endl;
+
+  // a basic header (5 bytes) would leave the blocks misaligned, the policy's
+  // alignment is raised to the type's
+  struct alignas(64) Line { double values[8]; };
+  TypedObjectAllocator<Point, OAPolicy<OAConfig::hbBasic, 0, 0, false, false,
+    8, 0> > headed;
+  TypedObjectAllocator<Line, OAPolicy<OAConfig::hbNone, 0, 0, false, false,
+    8, 0> > lines;
+  bool aligned = true;
+
+  for (int i = 0; i < 20; i++) {
+    aligned = aligned && reinterpret_cast<size_t>(headed.New(i, i)) %
+      alignof(Point) == 0;
+    aligned = aligned && reinterpret_cast<size_t>(lines.Allocate()) % 64 == 0;
+  }
+
+  cout << "Aligned for the type: " << (aligned ? "yes" : "no") << endl;
+}
+
+void PrintRetained(const ObjectAllocator* oa) {
+  cout << "Pages in use: " << oa->GetStats().PagesInUse_;
+  cout << ", Retained pages: " << oa->GetStats().RetainedPages_;
+  cout << ", Available objects: " << oa->GetStats().FreeObjects_ << endl;
+}
+
+void TestRetainedPages(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig config = DebugConfig(4, 0);
+    config.RetainEmptyPages_ = 2;
+    config.RetainIdleMs_ = 50;
+    oa = new ObjectAllocator(sizeof(Student), config);
+
+    void* p[16];
+    for (int i = 0; i < 16; i++) p[i] = oa->Allocate();
+    PrintRetained(oa);
+
+    // 4 empty pages, only 2 of them are kept
+    for (int i = 0; i < 16; i++) oa->Free(p[i]);
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintRetained(oa);
+
+    // the retained pages are reused as they are, no page is allocated
+    for (int i = 0; i < 5; i++) p[i] = oa->Allocate();
+    PrintRetained(oa);
+    cout << "Corrupted blocks: " << oa->ValidatePages(ValidateCallback) <<
+      endl;
+
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintRetained(oa);
+
+    // idle for longer than RetainIdleMs_, the next call lets them go
+    for (int i = 0; i < 5; i++) oa->Free(p[i]);
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintRetained(oa);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    cout << oa->FreeEmptyPages() << " pages freed" << endl;
+    PrintRetained(oa);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestRetainedPages." << endl;
+
+    return;
+  }
+
+  delete oa;
+}
+
+void TestSizeClasses(void) {
+  SizeClassAllocator* sca;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+    OAConfig config = DebugConfig(8, 0, header, 8);
+    sca = new SizeClassAllocator(config, 300);
+
+    cout << "Classes:";
+    for (size_t i = 0; i < sca->ClassCount(); i++) cout << " " << sca->
+      ClassSize(i);
+    cout << endl;
+
+    const size_t sizes[] = {0, 1, 16, 17, 48, 49, 100, 129, 200, 257, 320};
+    void* blocks[11];
+
+    for (int i = 0; i < 11; i++) {
+      blocks[i] = sca->Allocate(sizes[i]);
+      memset(blocks[i], 0x5A, sizes[i]);
+      cout << "Size " << sizes[i] << " -> class " << sca->ClassSize(sca->
+        ClassOf(sizes[i])) << endl;
+    }
+
+    // unsized frees find the class from the page directory, sized ones from
+    // the table
+    for (int i = 0; i < 11; i += 2) sca->Free(blocks[i]);
+    for (int i = 1; i < 11; i += 2) sca->Free(blocks[i], sizes[i]);
+
+    for (size_t i = 0; i < sca->ClassCount(); i++) {
+      const OAStats& stats = sca->GetClassStats(i);
+      if (stats.Allocations_ == 0) continue;
+      cout << "Class " << sca->ClassSize(i) << ": ";
+      PrintCounts(stats);
+    }
+
+    // enough for several pages per class, interleaved in the directory
+    void* many[200];
+    for (int i = 0; i < 200; i++) many[i] = sca->Allocate(size_t(i * 37 % 300));
+    for (int i = 199; i >= 0; i--) sca->Free(many[i]);
+
+    unsigned in_use = 0;
+    for (size_t i = 0; i < sca->ClassCount(); i++) in_use += sca->
+      GetClassStats(i).ObjectsInUse_;
+    cout << "Objects in use after unsized frees: " << in_use << endl;
+
+    try {
+      sca->Allocate(321);
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_NO_MEMORY) cout << "Too large" << endl;
+    }
+
+    try {
+      Student student;
+      sca->Free(&student);
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_BAD_BOUNDARY) cout <<
+        "Not owned by any class" << endl;
+    }
+
+    try {
+      void* block = sca->Allocate(40);
+      sca->Free(block);
+      sca->Free(block);
+    } catch (const OAException& e) {
+      if (e.code() == OAException::E_MULTIPLE_FREE) cout <<
+        "Double free detected" << endl;
+    }
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown during TestSizeClasses." << endl;
+
+    return;
+  }
+
+  delete sca;
+}
+
+unsigned PoolObjectsInUse(const ObjectPools& pools) {
+  unsigned in_use = 0;
+  for (size_t i = 0; i < pools.Count(); i++) in_use += pools.GetPool(i).
+    GetStats().ObjectsInUse_;
+  return in_use;
+}
+
+void TestPoolAllocator(void) {
+  typedef std::pair<const int, Student> Entry;
+  typedef std::map<int, Student, std::less<int>, PoolAllocator<Entry> >
+    StudentMap;
+  typedef std::list<int, PoolAllocator<int> > IntList;
+  typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+    PoolAllocator<std::pair<const int, int> > > IntHash;
+
+  std::shared_ptr<ObjectPools> pools = std::make_shared<ObjectPools>();
+
+  {
+    StudentMap map((std::less<int>()), PoolAllocator<Entry>(pools));
+
+    for (int i = 0; i < 500; i++) map[i].Age = i;
+    cout << "Map nodes: " << map.size() << ", pool objects in use: " <<
+      PoolObjectsInUse(*pools) << endl;
+
+    for (int i = 0; i < 500; i += 2) map.erase(i);
+    cout << "Map nodes: " << map.size() << ", pool objects in use: " <<
+      PoolObjectsInUse(*pools) << endl;
+
+    // copies and rebinds share the pools
+    StudentMap copy(map);
+    IntList list(copy.get_allocator());
+
+    for (int i = 0; i < 100; i++) list.push_back(i);
+    cout << "Map nodes: " << (map.size() + copy.size()) << ", list nodes: " <<
+      list.size() << ", pool objects in use: " << PoolObjectsInUse(*pools) <<
+      endl;
+    cout << "Allocators equal: " << (list.get_allocator() == map.
+      get_allocator() ? "yes" : "no") << endl;
+
+    // bucket arrays are not single objects, they come from operator new
+    IntHash hash(16, std::hash<int>(), std::equal_to<int>(),
+      PoolAllocator<std::pair<const int, int> >(pools));
+    const unsigned before = PoolObjectsInUse(*pools);
+
+    for (int i = 0; i < 200; i++) hash[i] = i * i;
+    cout << "Hash nodes from pool: " << (PoolObjectsInUse(*pools) - before ==
+      hash.size() ? "yes" : "no") << endl;
+
+    std::vector<int, PoolAllocator<int> > vec((PoolAllocator<int>(pools)));
+    for (int i = 0; i < 1000; i++) vec.push_back(i);
+    cout << "Vector size: " << vec.size() << endl;
+  }
+
+  cout << "Pool objects in use after destruction: " << PoolObjectsInUse(*
+    pools) << endl;
+
+  // the default pools are shared by every thread, and a list filled on one
+  // thread may well be destroyed on another
+  IntList* lists[4];
+  std::thread workers[4];
+
+  for (int t = 0; t < 4; t++) {
+    lists[t] = new IntList;
+    workers[t] = std::thread([&lists, t] {
+      for (int i = 0; i < 1000; i++) lists[t]->push_back(i);
+    });
+  }
+
+  for (int t = 0; t < 4; t++) workers[t].join();
+  for (int t = 0; t < 4; t++) workers[t] = std::thread([&lists, t] {
+    delete lists[(t + 1) % 4];
+  });
+  for (int t = 0; t < 4; t++) workers[t].join();
+
+  cout << "Default pool objects in use after threads: " << PoolObjectsInUse(
+    *ObjectPools::Default()) << endl;
+
+  // new[] only aligns on max_align_t, no Alignment_ can make up for it
+  struct alignas(64) Line { char bytes[64]; };
+  std::shared_ptr<ObjectPools> newdel = std::make_shared<ObjectPools>(
+    OAConfig(true, 8, 0));
+
+  try {
+    PoolAllocator<Line>(newdel).allocate(1);
+  } catch (const std::bad_alloc&) {
+    cout << "Over-aligned type refused" << endl;
+  }
+
+  try {
+    PoolAllocator<Student> students(pools);
+    students.allocate(students.max_size() + 1);
+  } catch (const std::bad_array_new_length&) {
+    cout << "Too many objects refused" << endl;
+  }
+}
+
+void TestShardedAllocator(void) {
+  ShardedAllocator* sa;
+  const unsigned threads = 4;
+  const unsigned count = 500;
+
+  try {
+    OAConfig config = DebugConfig(64, 0);
+    sa = new ShardedAllocator(sizeof(Student), config, 16);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestShardedAllocator");
+
+    return;
+  }
+
+  cout << "Shards: " << (sa->ShardCount() >= 1 ? "ok" : "none") << endl;
+  PrintCounts(sa->GetStats());
+
+  // each worker keeps 100 objects alive and hands the rest back, wherever
+  // the scheduler puts it
+  std::thread workers[threads];
+  void* kept[threads][100];
+
+  for (unsigned t = 0; t < threads; t++) {
+    workers[t] = std::thread([sa, t, &kept]() {
+      void* ptrs[count];
+      for (unsigned i = 0; i < count; i++) ptrs[i] = sa->Allocate();
+      for (unsigned i = 100; i < count; i++) sa->Free(ptrs[i]);
+      for (unsigned i = 0; i < 100; i++) kept[t][i] = ptrs[i];
+    });
+  }
+
+  for (unsigned t = 0; t < threads; t++) workers[t].join();
+
+  PrintCounts(sa->GetStats());
+
+  // every page belongs to exactly one shard
+  unsigned pages = 0;
+  for (unsigned i = 0; i < sa->ShardCount(); i++)
+    pages += sa->GetShardStats(i).PagesInUse_;
+  cout << "Shard pages add up: " << (pages == sa->GetStats().PagesInUse_ ?
+    "yes" : "no") << endl;
+
+  try {
+    for (unsigned t = 0; t < threads; t++)
+      for (unsigned i = 0; i < 100; i++) sa->Free(kept[t][i]);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestShardedAllocator." << endl;
+  }
+
+  PrintCounts(sa->GetStats());
+
+  delete sa;
+}
+
+void TestRemoteFree(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig config = DebugConfig(8, 0);
+    config.RemoteFree_ = true;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestRemoteFree");
+
+    return;
+  }
+
+  // produced here, consumed (and freed) on another thread
+  void* ptrs[40];
+  for (unsigned i = 0; i < 40; i++) ptrs[i] = oa->Allocate();
+
+  std::thread consumer([oa, &ptrs]() {
+    for (unsigned i = 0; i < 20; i++) oa->Free(ptrs[i]);
+    oa->FreeBatch(ptrs + 20, 10);
+  });
+  consumer.join();
+
+  // nothing is freed until the owner drains the queue
+  PrintCounts(oa);
+
+  // the free list is empty, so this drains instead of growing a page
+  void* extra = oa->Allocate();
+  PrintCounts(oa);
+
+  std::thread twice([oa, &ptrs]() {
+    oa->Free(ptrs[30]);
+    oa->Free(ptrs[30]);
+  });
+  twice.join();
+
+  try {
+    oa->DrainRemoteFrees();
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_MULTIPLE_FREE)
+      cout << "****** Freeing object twice. ******" << endl;
+  }
+
+  try {
+    for (unsigned i = 31; i < 40; i++) oa->Free(ptrs[i]);
+    oa->Free(extra);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestRemoteFree." << endl;
+  }
+
+  PrintCounts(oa);
+  cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+  PrintCounts(oa);
+
+  delete oa;
+}
+
+void TestCacheLineLayout(void) {
+  for (int mapped = 0; mapped < 2; mapped++) {
+    ObjectAllocator* oa;
+
+    try {
+      OAConfig::HeaderBlockInfo header(OAConfig::hbBasic);
+      OAConfig config = DebugConfig(8, 0, header, 8);
+      config.CacheLineLayout_ = true;
+      if (mapped) config.PageBackend_ = OAConfig::pbMapped;
+      oa = new ObjectAllocator(sizeof(Student), config);
+    } catch (const OAException& e) {
+      ConstructionFailed(e, "TestCacheLineLayout");
+
+      return;
+    }
+
+    PrintConfig(oa);
+
+    // every object starts a line and no line holds two objects
+    void* ptrs[20];
+    bool own_lines = true;
+    for (unsigned i = 0; i < 20; i++) {
+      ptrs[i] = oa->Allocate();
+      size_t line = reinterpret_cast<size_t>(ptrs[i]) / 64;
+      if (reinterpret_cast<size_t>(ptrs[i]) % 64 != 0) own_lines = false;
+      for (unsigned j = 0; j < i; j++)
+        if (reinterpret_cast<size_t>(ptrs[j]) / 64 == line) own_lines = false;
+      std::memset(ptrs[i], 0x55, sizeof(Student));
+    }
+    cout << "Objects on their own lines: " << (own_lines ? "yes" : "no") << endl;
+
+    try {
+      for (unsigned i = 0; i < 20; i++) oa->Free(ptrs[i]);
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown from Free in TestCacheLineLayout." << endl;
+    }
+
+    PrintCounts(oa);
+    cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+
+    delete oa;
+  }
+}
+
+void TestFullestPagePolicy(void) {
+  const char* names[] = {"LIFO", "Fullest page"};
+
+  for (int policy = 0; policy < 2; policy++) {
+    ObjectAllocator* oa;
+
+    try {
+      OAConfig config = DebugConfig(8, 0);
+      if (policy) config.AllocationPolicy_ = OAConfig::apFullestPage;
+      oa = new ObjectAllocator(sizeof(Student), config);
+    } catch (const OAException& e) {
+      ConstructionFailed(e, "TestFullestPagePolicy");
+
+      return;
+    }
+
+    cout << names[policy] << ":" << endl;
+
+    // fill 32 pages, keep a quarter, then churn: free a random object and
+    // allocate a replacement
+    Digipen::Utils::srand(8, 3);
+    void* live[256];
+    unsigned count = 256;
+
+    try {
+      for (unsigned i = 0; i < count; i++) live[i] = oa->Allocate();
+
+      while (count > 64) {
+        unsigned victim = static_cast<unsigned>(RandomInt(0, static_cast<int>(
+          count) - 1));
+        oa->Free(live[victim]);
+        live[victim] = live[--count];
+      }
+
+      for (unsigned round = 0; round < 2000; round++) {
+        unsigned victim = static_cast<unsigned>(RandomInt(0, static_cast<int>(
+          count) - 1));
+        oa->Free(live[victim]);
+        live[victim] = oa->Allocate();
+      }
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown in TestFullestPagePolicy." << endl;
+    }
+
+    PrintCounts(oa);
+    cout << "Objects dumped: " << oa->DumpMemoryInUse(DumpCallback2) << endl;
+    cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+    PrintCounts(oa);
+
+    try {
+      for (unsigned i = 0; i < count; i++) oa->Free(live[i]);
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown from Free in TestFullestPagePolicy." <<
+        endl;
+    }
+
+    cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+    PrintCounts(oa);
+
+    delete oa;
+  }
+
+  // a page down to one object is still fuller than an empty one, so the next
+  // block comes from it and the empty page can be freed
+  try {
+    OAConfig config = DebugConfig(64, 0);
+    config.AllocationPolicy_ = OAConfig::apFullestPage;
+    ObjectAllocator oa(sizeof(Student), config);
+    void* blocks[128];
+
+    for (unsigned i = 0; i < 128; i++) blocks[i] = oa.Allocate();
+    for (unsigned i = 1; i < 128; i++) oa.Free(blocks[i]);
+    blocks[1] = oa.Allocate();
+
+    cout << "Empty pages freed after one more allocation: " <<
+      oa.FreeEmptyPages() << endl;
+
+    // a batch takes every block it needs before marking any in use, this
+    // one runs through the rest of the page onto a new one
+    void* batch[100];
+    oa.AllocateBatch(batch, 100);
+    cout << "Batch across pages: " << oa.GetStats().ObjectsInUse_ <<
+      " objects in use on " << oa.GetStats().PagesInUse_ << " pages" << endl;
+    oa.FreeBatch(batch, 100);
+
+    oa.Free(blocks[0]);
+    oa.Free(blocks[1]);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestFullestPagePolicy." << endl;
+  }
+}
+
+void TestHandles(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbExtended, 2);
+    OAConfig config = DebugConfig(4, 0, header);
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestHandles");
+
+    return;
+  }
+
+  cout << "Handle size: " << sizeof(OAHandle) << endl;
+
+  OAHandle handles[10];
+
+  try {
+    for (unsigned i = 0; i < 10; i++) handles[i] = oa->AllocateHandle();
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from AllocateHandle in TestHandles." << endl;
+  }
+
+  PrintCounts(oa);
+
+  bool resolved = true;
+  for (unsigned i = 0; i < 10; i++)
+    resolved = resolved && oa->Resolve(handles[i]) != 0 &&
+      oa->HandleOf(oa->Resolve(handles[i])) == handles[i];
+  cout << "All handles resolve: " << (resolved ? "yes" : "no") << endl;
+
+  // free one, its handle goes stale and stays stale once the block is reused
+  OAHandle old = handles[5];
+  void* block = oa->Resolve(old);
+
+  try {
+    oa->FreeHandle(old);
+    cout << "Stale handle resolves: " << (oa->Resolve(old) ? "yes" : "no") <<
+      endl;
+
+    handles[5] = oa->AllocateHandle();
+    cout << "Same block reused: " << (oa->Resolve(handles[5]) == block ?
+      "yes" : "no") << endl;
+    cout << "New handle differs: " << (handles[5] != old ? "yes" : "no") <<
+      endl;
+    cout << "Stale handle resolves: " << (oa->Resolve(old) ? "yes" : "no") <<
+      endl;
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestHandles." << endl;
+  }
+
+  try {
+    oa->FreeHandle(old);
+    cout << "Stale handle freed!" << endl;
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_MULTIPLE_FREE)
+      cout << "Stale handle: E_MULTIPLE_FREE" << endl;
+    else cout << "Stale handle: unexpected exception" << endl;
+  }
+
+  try {
+    oa->FreeHandle(0xFFFFFF00u);
+    cout << "Bogus handle freed!" << endl;
+  } catch (const OAException& e) {
+    if (e.code() == OAException::E_BAD_BOUNDARY)
+      cout << "Bogus handle: E_BAD_BOUNDARY" << endl;
+    else cout << "Bogus handle: unexpected exception" << endl;
+  }
+
+  cout << "Null handle resolves: " << (oa->Resolve(NULL_HANDLE) ? "yes" :
+    "no") << endl;
+
+  try {
+    for (unsigned i = 0; i < 10; i++) oa->FreeHandle(handles[i]);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from FreeHandle in TestHandles." << endl;
+  }
+
+  PrintCounts(oa);
+  delete oa;
+}
+
+struct Relocations {
+  Student* live[256];
+  OAHandle handles[256];
+  unsigned count;
+  unsigned moved;
+  bool ok;
+};
+
+void RelocateCallback(void* from, void* to, OAHandle old_handle,
+  OAHandle new_handle, void* context) {
+  Relocations* r = static_cast<Relocations*>(context);
+  r->moved++;
+
+  for (unsigned i = 0; i < r->count; i++) {
+    if (r->live[i] != from) continue;
+
+    r->live[i] = static_cast<Student*>(to);
+    r->ok = r->ok && r->handles[i] == old_handle &&
+      r->live[i]->ID == static_cast<long long>(i);
+    r->handles[i] = new_handle;
+    return;
+  }
+
+  r->ok = false;
+}
+
+void TestCompact(void) {
+  const char* names[] = {"LIFO, extended headers",
+    "Fullest page, external headers"};
+
+  for (int policy = 0; policy < 2; policy++) {
+    ObjectAllocator* oa;
+
+    try {
+      OAConfig::HeaderBlockInfo header(policy ? OAConfig::hbExternal :
+        OAConfig::hbExtended, policy ? 0 : 2);
+      OAConfig config = DebugConfig(16, 0, header);
+      if (policy) config.AllocationPolicy_ = OAConfig::apFullestPage;
+      oa = new ObjectAllocator(sizeof(Student), config);
+    } catch (const OAException& e) {
+      ConstructionFailed(e, "TestCompact");
+
+      return;
+    }
+
+    cout << names[policy] << ":" << endl;
+
+    // 16 pages, then free all but one in 8 objects (at random)
+    Relocations r;
+    r.count = 256;
+    r.moved = 0;
+    r.ok = true;
+    Digipen::Utils::srand(20, 4);
+
+    try {
+      for (unsigned i = 0; i < r.count; i++) {
+        r.handles[i] = oa->AllocateHandle("compact");
+        r.live[i] = static_cast<Student*>(oa->Resolve(r.handles[i]));
+        r.live[i]->ID = static_cast<long long>(i);
+      }
+
+      unsigned keep = 0;
+      for (unsigned i = 0; i < r.count; i++) {
+        if (RandomInt(0, 7) != 0) {
+          oa->FreeHandle(r.handles[i]);
+          continue;
+        }
+
+        r.live[keep] = r.live[i];
+        r.handles[keep] = r.handles[i];
+        r.live[keep]->ID = static_cast<long long>(keep);
+        keep++;
+      }
+      r.count = keep;
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown in TestCompact." << endl;
+    }
+
+    cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+    PrintCounts(oa);
+
+    try {
+      unsigned moved;
+      do {
+        moved = oa->Compact(8, RelocateCallback, &r);
+        cout << "Moved " << moved << ", pages in use: " <<
+          oa->GetStats().PagesInUse_ << endl;
+      } while (moved != 0);
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown from Compact in TestCompact." << endl;
+    }
+
+    PrintCounts(oa);
+
+    bool intact = r.ok;
+    for (unsigned i = 0; i < r.count; i++)
+      intact = intact && oa->Resolve(r.handles[i]) == r.live[i] &&
+        r.live[i]->ID == static_cast<long long>(i);
+    cout << "Callbacks: " << r.moved << ", objects intact: " << (intact ?
+      "yes" : "no") << endl;
+    cout << "Objects dumped: " << oa->DumpMemoryInUse(DumpCallback2) << endl;
+    cout << "Corrupted blocks: " << oa->ValidatePages(DumpCallback2) << endl;
+
+    try {
+      for (unsigned i = 0; i < r.count; i++) oa->FreeHandle(r.handles[i]);
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown from FreeHandle in TestCompact." << endl;
+    }
+
+    cout << "Empty pages freed: " << oa->FreeEmptyPages() << endl;
+    PrintCounts(oa);
+
+    delete oa;
+  }
+}
+
+void TestForEachLive(void) {
+  const char* names[] = {"Eager pages", "Lazy pages"};
+
+  for (int lazy = 0; lazy < 2; lazy++) {
+    ObjectAllocator* oa;
+
+    try {
+      OAConfig::HeaderBlockInfo header(OAConfig::hbNone);
+      OAConfig config = DebugConfig(70, 0, header);
+      config.LazyPageInit_ = lazy != 0;
+      oa = new ObjectAllocator(sizeof(Student), config);
+    } catch (const OAException& e) {
+      ConstructionFailed(e, "TestForEachLive");
+
+      return;
+    }
+
+    cout << names[lazy] << ":" << endl;
+
+    // 3 and a bit pages, every third object freed
+    Student* students[220];
+    long long expected = 0;
+
+    try {
+      for (unsigned i = 0; i < 220; i++) {
+        students[i] = static_cast<Student*>(oa->Allocate());
+        students[i]->ID = i;
+      }
+
+      for (unsigned i = 0; i < 220; i++) {
+        if (i % 3 == 0) oa->Free(students[i]);
+        else expected += i;
+      }
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown in TestForEachLive." << endl;
+    }
+
+    PrintCounts(oa);
+
+    unsigned visited = 0;
+    long long sum = 0;
+    const Student* previous = 0;
+    bool ordered = true;
+
+    oa->ForEachLive<Student>([&](Student* student) {
+      visited++;
+      sum += student->ID;
+      ordered = ordered && student > previous;
+      previous = student;
+    });
+
+    cout << "Visited: " << visited << ", dumped: " <<
+      oa->DumpMemoryInUse(DumpCallback2) << endl;
+    cout << "IDs match: " << (sum == expected ? "yes" : "no") <<
+      ", address order: " << (ordered ? "yes" : "no") << endl;
+
+    unsigned page_number = 0;
+    for (const ObjectAllocator::LivePage page : oa->Pages()) {
+      unsigned counted = 0;
+      page.ForEachLive([&counted](void*) { counted++; });
+
+      cout << "Page " << page_number++ << ": " << page.live << " live of " <<
+        page.blocks << " carved, " << counted << " visited" << endl;
+    }
+
+    try {
+      for (unsigned i = 0; i < 220; i++)
+        if (i % 3 != 0) oa->Free(students[i]);
+    } catch (const OAException& e) {
+      if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+      else cout << "Exception thrown from Free in TestForEachLive." << endl;
+    }
+
+    visited = 0;
+    oa->ForEachLive([&visited](void*) { visited++; });
+    cout << "Visited after freeing everything: " << visited << endl;
+
+    delete oa;
+  }
+}
+
+void PrintProfile(const ObjectAllocator* oa,
+  ObjectAllocator::PROFILE_GROUPING grouping) {
+  OAProfileEntry rows[16];
+  usize count = oa->GetProfile(rows, 16, grouping);
+
+  for (usize i = 0; i < count && i < 16; i++) {
+    cout << "  " << (rows[i].label ? rows[i].label : "(none)") <<
+      ": live objects " << rows[i].live_objects << ", live bytes " <<
+      rows[i].live_bytes << ", allocations " << rows[i].allocations <<
+      ", frees " << rows[i].deallocations << endl;
+  }
+}
+
+struct PointerTable {
+  void** pointers;
+  unsigned count;
+};
+
+void RelocatePointers(void* from, void* to, OAHandle, OAHandle,
+  void* context) {
+  PointerTable* tables = static_cast<PointerTable*>(context);
+
+  for (unsigned t = 0; t < 2; t++)
+    for (unsigned i = 0; i < tables[t].count; i++)
+      if (tables[t].pointers[i] == from) tables[t].pointers[i] = to;
+}
+
+void TestProfile(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbExternal);
+    OAConfig config = DebugConfig(8, 0, header);
+    config.Profile_ = true;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestProfile");
+
+    return;
+  }
+
+  void* meshes[15];
+  void* sounds[7];
+  void* other[9];
+  char buffer[16];
+
+  try {
+    // the same label from two call sites
+    for (unsigned i = 0; i < 10; i++) meshes[i] = oa->Allocate("Mesh");
+    for (unsigned i = 10; i < 15; i++) meshes[i] = oa->Allocate("Mesh");
+
+    oa->AllocateBatch(sounds, 7, "Audio");
+
+    for (unsigned i = 0; i < 3; i++) other[i] = oa->Allocate();
+
+    // one buffer holding two labels in turn
+    strcpy(buffer, "Net");
+    for (unsigned i = 3; i < 5; i++) other[i] = oa->Allocate(buffer);
+    strcpy(buffer, "Physics");
+    for (unsigned i = 5; i < 9; i++) other[i] = oa->Allocate(buffer);
+
+    for (unsigned i = 0; i < 4; i++) oa->Free(meshes[i]);
+    oa->FreeBatch(sounds, 7);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestProfile." << endl;
+  }
+
+  PrintCounts(oa);
+  cout << "By label:" << endl;
+  PrintProfile(oa, ObjectAllocator::pgLabel);
+
+  OAProfileEntry sites[16];
+  usize count = oa->GetProfile(sites, 16, ObjectAllocator::pgCallSite);
+  unsigned mesh_sites = 0;
+  bool callers = true;
+  for (usize i = 0; i < count; i++) {
+    if (sites[i].label && strcmp(sites[i].label, "Mesh") == 0) mesh_sites++;
+    callers = callers && sites[i].caller != 0;
+  }
+  cout << "Call sites: " << count << ", for Mesh: " << mesh_sites <<
+    ", all with a caller: " << (callers ? "yes" : "no") << endl;
+
+  // moved objects stay with the site that allocated them
+  PointerTable tables[2] = {{meshes, 15}, {other, 9}};
+  cout << "Moved by Compact: " << oa->Compact(100, RelocatePointers, tables) <<
+    endl;
+  PrintCounts(oa);
+
+  try {
+    for (unsigned i = 4; i < 15; i++) oa->Free(meshes[i]);
+    oa->FreeBatch(other, 9);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestProfile." << endl;
+  }
+
+  cout << "By label, after freeing everything:" << endl;
+  PrintProfile(oa, ObjectAllocator::pgLabel);
+
+  delete oa;
+}
+
+void TestHeapSampling(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig config = DebugConfig(8, 0);
+    config.SampleInterval_ = 1;
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestHeapSampling");
+
+    return;
+  }
+
+  // every allocation is sampled
+  void* ptrs[40];
+  PointerTable tables[2] = {{ptrs, 40}, {ptrs, 0}};
+
+  try {
+    for (unsigned i = 0; i < 20; i++) ptrs[i] = oa->Allocate("Mesh");
+    oa->AllocateBatch(ptrs + 20, 20, "Audio");
+    cout << "Sampled objects: " << oa->SampledObjects() << endl;
+
+    for (unsigned i = 0; i < 40; i += 3) oa->Free(ptrs[i]);
+    for (unsigned i = 0; i < 40; i += 3) ptrs[i] = 0;
+    cout << "Sampled objects after freeing: " << oa->SampledObjects() << endl;
+
+    cout << "Moved by Compact: " << oa->Compact(100, RelocatePointers, tables)
+      << endl;
+    cout << "Sampled objects after Compact: " << oa->SampledObjects() << endl;
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestHeapSampling." << endl;
+  }
+
+  const char* path = "oa_heap_profile.pb";
+  bool written = oa->WriteHeapProfile(path);
+  long size = 0;
+  FILE* file = fopen(path, "rb");
+  if (file) {
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+  }
+  remove(path);
+  cout << "Profile written: " << (written && size > 0 ? "yes" : "no") << endl;
+
+  try {
+    for (unsigned i = 0; i < 40; i++) oa->Free(ptrs[i]);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestHeapSampling." << endl;
+  }
+
+  cout << "Sampled objects after freeing everything: " <<
+    oa->SampledObjects() << endl;
+  delete oa;
+  oa = 0;
+
+  // one in 64 on average
+  try {
+    OAConfig config(false, 64, 0);
+    config.SampleInterval_ = 64;
+    oa = new ObjectAllocator(sizeof(Student), config);
+
+    static void* many[6400];
+    for (unsigned i = 0; i < 6400; i++) many[i] = oa->Allocate();
+
+    usize sampled = oa->SampledObjects();
+    cout << "Sampled about 1 in 64: " << (sampled > 50 && sampled < 150 ?
+      "yes" : "no") << endl;
+
+    for (unsigned i = 0; i < 6400; i++) oa->Free(many[i]);
+    cout << "Sampled objects after freeing everything: " <<
+      oa->SampledObjects() << endl;
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestHeapSampling." << endl;
+  }
+
+  delete oa;
+}
+
+MemBlockInfo* ExternalInfo(const ObjectAllocator* oa, void* block) {
+  size_t offset = oa->GetConfig().PadBytes_ + oa->GetConfig().HBlockInfo_.size_;
+  return *reinterpret_cast<MemBlockInfo**>(static_cast<char*>(block) - offset);
+}
+
+void TestInternedLabels(void) {
+  ObjectAllocator* oa;
+
+  try {
+    OAConfig::HeaderBlockInfo header(OAConfig::hbExternal);
+    OAConfig config = DebugConfig(4, 0, header);
+    oa = new ObjectAllocator(sizeof(Student), config);
+  } catch (const OAException& e) {
+    ConstructionFailed(e, "TestInternedLabels");
+
+    return;
+  }
+
+  void* blocks[8] = {0};
+  char buffer[16];
+
+  try {
+    // one buffer holding two labels in turn, then a string literal
+    strcpy(buffer, "Mesh");
+    for (unsigned i = 0; i < 3; i++) blocks[i] = oa->Allocate(buffer);
+    strcpy(buffer, "Texture");
+    for (unsigned i = 3; i < 6; i++) blocks[i] = oa->Allocate(buffer);
+    blocks[6] = oa->Allocate("Mesh");
+    blocks[7] = oa->Allocate();
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Allocate in TestInternedLabels." << endl;
+  }
+
+  PrintCounts(oa);
+
+  MemBlockInfo* mesh = ExternalInfo(oa, blocks[0]);
+  MemBlockInfo* texture = ExternalInfo(oa, blocks[3]);
+
+  cout << "Labels: " << mesh->label << ", " << texture->label << ", " <<
+    (ExternalInfo(oa, blocks[7])->label ? "?" : "(none)") << endl;
+  cout << "Label copied: " << (mesh->label != buffer ? "yes" : "no") << endl;
+  cout << "Same label shared: " << (ExternalInfo(oa, blocks[1])->label ==
+    mesh->label && ExternalInfo(oa, blocks[6])->label == mesh->label &&
+    ExternalInfo(oa, blocks[5])->label == texture->label ? "yes" : "no") <<
+    endl;
+  cout << "Labels interned: " << oa->InternedLabels() << endl;
+
+  // a freed record is handed to the next block allocated
+  try {
+    MemBlockInfo* record = ExternalInfo(oa, blocks[4]);
+    oa->Free(blocks[4]);
+    blocks[4] = oa->Allocate("Texture");
+    cout << "Record reused: " << (ExternalInfo(oa, blocks[4]) == record ?
+      "yes" : "no") << endl;
+    cout << "Label reused: " << (record->label == texture->label ? "yes" :
+      "no") << endl;
+    cout << "Alloc #: " << record->alloc_num << endl;
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown in TestInternedLabels." << endl;
+  }
+
+  try {
+    for (unsigned i = 0; i < 8; i++) oa->Free(blocks[i]);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown from Free in TestInternedLabels." << endl;
+  }
+
+  // nothing holds the labels any more
+  PrintCounts(oa);
+  cout << "Pages freed: " << oa->FreeEmptyPages() << endl;
+  cout << "Labels interned: " << oa->InternedLabels() << endl;
+
+  delete oa;
+
+  // the typed allocator's external headers come from the same kind of pool
+  try {
+    typedef OAPolicy<OAConfig::hbExternal, 2, 0, true, true, 4> Policy;
+    typedef TypedObjectAllocator<Student, Policy> Typed;
+    Typed typed;
+    const auto info = [](Student* block) {
+      return *reinterpret_cast<MemBlockInfo**>(reinterpret_cast<char*>(block) -
+        Policy::PadBytes_ - Typed::HEADER_SIZE);
+    };
+
+    strcpy(buffer, "Mesh");
+    Student* first = typed.Allocate(buffer);
+    Student* second = typed.Allocate("Mesh");
+    MemBlockInfo* record = info(second);
+    const char* label = record->label;
+
+    typed.Free(second);
+    second = typed.Allocate("Mesh");
+    cout << "Typed label shared: " << (info(first)->label == label &&
+      label != buffer ? "yes" : "no") << ", record reused: " <<
+      (info(second) == record ? "yes" : "no") << endl;
+
+    typed.Free(first);
+    typed.Free(second);
+  } catch (const OAException& e) {
+    if (SHOW_EXCEPTIONS) cout << e.what() << endl;
+    else cout << "Exception thrown by the typed allocator in " <<
+      "TestInternedLabels." << endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  #ifdef _MSC_VER
+    _CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
+    _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_WARN, _CRTDBG_FILE_STDERR);
+  #endif
+
+  int test = 0;
+
+  if (argc > 1) test = std::atoi(argv[1]);
+  if (argc > 2) SHOWADDRESS1 = std::atoi(argv[2]);
+  if (argc > 3) SHOWADDRESS2 = std::atoi(argv[3]);
+  if (argc > 4) SHOWREAL = std::atoi(argv[4]);
+  if (argc > 5) SHOW_EXCEPTIONS = std::atoi(argv[5]);
+  if (argc > 6) EXTRA_CREDIT = std::atoi(argv[6]);
+
+  switch (test) {
+    case 1: cout << "============================== Students..." << endl;
+      DoStudents(0, false);
+      cout << endl;
+      break;
+    case 2: cout << "============================== Students..." << endl;
+      DoStudents(0, true);
+      cout << endl;
+      break;
+    case 3: cout << "============================== Employees..." << endl;
+      DoEmployees();
+      cout << endl;
+      break;
+    case 4: cout << "============================== Test padding..." << endl;
+      TestPadding(6);
+      cout << endl;
+      break;
+    case 5: cout << "============================== Test padding..." << endl;
+      TestPadding(10);
+      cout << endl;
+      break;
+    case 6: cout << "============================== Test basic header blocks..."
+            << endl;
+      TestBasicHeaderBlocks();
+      cout << endl;
+      break;
+    case 7: cout <<
+            "============================== Test extended header blocks(1)..."
+            << endl;
+      TestExtendedHeaderBlocks(1);
+      cout << endl;
+      break;
+    case 8: cout <<
+            "============================== Test external header blocks..." <<
+            endl;
+      TestExternalHeaderBlocks();
+      cout << endl;
+      break;
+    case 9: cout << "============================== Test corruption..." << endl;
+      TestCorruption();
+      cout << endl;
+      break;
+    case 10: cout << "============================== Test using new/delete..."
+             << endl;
+      DisableOA();
+      cout << endl;
+      break;
+    case 11: cout << "============================== Test leak..." << endl;
+      TestLeak();
+      cout << endl;
+      break;
+    case 12: cout << "============================== Test validate..." << endl;
+      TestValidate();
+      cout << endl;
+      break;
+    case 13: cout <<
+             "============================== Test free checking basic (stress)..."
+             << endl;
+      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbBasic));
+      cout << endl;
+      break;
+    case 14: cout <<
+             "============================== Test free checking extended (stress)..."
+             << endl;
+      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbExtended, 1));
+      cout << endl;
+      break;
+    case 15: cout <<
+             "============================== Test free checking external (stress)..."
+             << endl;
+      StressFreeChecking(OAConfig::HeaderBlockInfo(OAConfig::hbExternal));
+      cout << endl;
+      break;
+    case 16: cout <<
+             "============================== Test stress using new/delete..." <<
+             endl;
+      Stress(true);
+      cout << endl;
+      break;
+    case 17: cout <<
+             "============================== Test stress using allocator..." <<
+             endl;
+      Stress(false);
+      cout << endl;
+      break;
+    case 18: cout << "============================== Test alignment..." << endl;
+      TestAlignment();
+      cout << endl;
+      break;
+    case 19: cout << "============================== Test free empty pages 1..."
+             << endl;
+      TestFreeEmptyPages1();
+      cout << endl;
+      break;
+    case 20: cout << "============================== Test free empty pages 2..."
+             << endl;
+      TestFreeEmptyPages2();
+      cout << endl;
+      break;
+    case 21: cout << "============================== Test free empty pages 3..."
+             << endl;
+      TestFreeEmptyPages4();
+      cout << endl;
+      break;
+    case 22: cout << "============================== Test thread cache..."
+             << endl;
+      TestThreadCache();
+      cout << endl;
+      break;
+    case 23: cout <<
+             "============================== Test concurrent free list..." <<
+             endl;
+      TestConcurrentFreeList();
+      cout << endl;
+      break;
+    case 24: cout << "============================== Test batch..." << endl;
+      TestBatch();
+      cout << endl;
+      break;
+    case 25: cout << "============================== Test mapped pages..." <<
+             endl;
+      TestMappedPages();
+      cout << endl;
+      break;
+    case 26: cout << "============================== Test lazy pages..." << endl;
+      TestLazyPages();
+      cout << endl;
+      break;
+    case 27: cout << "============================== Test typed allocator..." <<
+             endl;
+      TestTypedAllocator();
+      cout << endl;
+      break;
+    case 28: cout << "============================== Test retained pages..." <<
+             endl;
+      TestRetainedPages();
+      cout << endl;
+      break;
+    case 29: cout << "============================== Test size classes..." <<
+             endl;
+      TestSizeClasses();
+      cout << endl;
+      break;
+    case 30: cout << "============================== Test pool allocator..." <<
+             endl;
+      TestPoolAllocator();
+      cout << endl;
+      break;
+    case 31: cout << "============================== Test sharded allocator..."
+             << endl;
+      TestShardedAllocator();
+      cout << endl;
+      break;
+    case 32: cout << "============================== Test remote free..." << endl;
+      TestRemoteFree();
+      cout << endl;
+      break;
+    case 33: cout << "============================== Test cache line layout..." <<
+             endl;
+      TestCacheLineLayout();
+      cout << endl;
+      break;
+    case 34: cout << "============================== Test fullest page policy..."
+             << endl;
+      TestFullestPagePolicy();
+      cout << endl;
+      break;
+    case 35: cout << "============================== Test handles..." << endl;
+      TestHandles();
+      cout << endl;
+      break;
+    case 36: cout << "============================== Test compact..." << endl;
+      TestCompact();
+      cout << endl;
+      break;
+    case 37: cout << "============================== Test for each live..." <<
+             endl;
+      TestForEachLive();
+      cout << endl;
+      break;
+    case 38: cout << "============================== Test profile..." << endl;
+      TestProfile();
+      cout << endl;
+      break;
+    case 39: cout << "============================== Test heap sampling..." <<
+             endl;
+      TestHeapSampling();
+      cout << endl;
+      break;
+    case 40: cout << "============================== Test interned labels..." <<
+             endl;
+      TestInternedLabels();
       cout << endl;
       break;
     default: cout << "============================== Students..." << endl;
@@ -0,0 +1,108 @@
+#include "ObjectAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// One small counter per thread, allocated back to back from one allocator, every thread bumping only its own
+namespace {
+  struct Counter {
+    std::atomic<u64> value;
+  };
+
+  constexpr unsigned INCREMENTS = 20000000;
+  constexpr unsigned ROUNDS = 5;
+
+  double contend(const OAConfig& config, const unsigned threads, usize& lines) {
+    ObjectAllocator oa(sizeof(Counter), config);
+    std::vector<Counter*> counters(threads);
+
+    for (unsigned t = 0; t < threads; t++) {
+      counters[t] = new (oa.Allocate()) Counter{{0}};
+    }
+
+    std::vector<usize> distinct;
+
+    for (const Counter* counter : counters) {
+      distinct.push_back(reinterpret_cast<uptr>(counter) / CACHE_LINE_SIZE);
+    }
+
+    std::sort(distinct.begin(), distinct.end());
+    lines = static_cast<usize>(std::unique(distinct.begin(), distinct.end()) - distinct.begin());
+
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> ready{0};
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (unsigned t = 0; t < threads; t++) {
+      workers.emplace_back([&, t] {
+        ready.fetch_add(1);
+
+        while (ready.load() != threads) {
+        }
+
+        // a plain load + store (no locked instruction), only the line's ownership moves between cores
+        std::atomic<u64>& value = counters[t]->value;
+
+        for (unsigned i = 0; i < INCREMENTS; i++) {
+          value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+      });
+    }
+
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (Counter* counter : counters) {
+      oa.Free(counter);
+    }
+
+    return ms;
+  }
+
+  void report(const char* name, const OAConfig& config, const unsigned threads) {
+    double best = 0;
+    usize lines = 0;
+
+    for (unsigned r = 0; r < ROUNDS; r++) {
+      const double ms = contend(config, threads, lines);
+      best = r == 0 or ms < best ? ms : best;
+    }
+
+    std::printf(
+      "%-32s %2zu lines  %8.2f ms  %6.2f ns/increment\n", name, lines, best, best * 1e6 / INCREMENTS
+    );
+  }
+}
+
+int main() {
+  const unsigned threads = std::max(2u, std::thread::hardware_concurrency());
+
+  std::printf(
+    "%u threads, %u increments each on a %zu byte counter, best of %u rounds\n",
+    threads,
+    INCREMENTS,
+    sizeof(Counter),
+    ROUNDS
+  );
+
+  OAConfig packed(false, 64, 0);
+  report("Packed blocks", packed, threads);
+
+  OAConfig aligned(false, 64, 0);
+  aligned.Alignment_ = 16;
+  report("Alignment_ = 16", aligned, threads);
+
+  OAConfig lines(false, 64, 0);
+  lines.CacheLineLayout_ = true;
+  report("CacheLineLayout_", lines, threads);
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "ObjectAllocator.h"
+#include "ObjectPoolResource.h"
+#include "PRNG.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <vector>
+
+// The driver's Stress workload: fill 100 pages of 4096 Students, free them all in random order
+namespace {
+  struct Student {
+    int Age;
+    float GPA;
+    long long Year;
+    long long ID;
+  };
+
+  constexpr unsigned OBJECTS = 4096;
+  constexpr unsigned PAGES = 100;
+  constexpr unsigned TOTAL = OBJECTS * PAGES;
+  constexpr unsigned ROUNDS = 10;
+
+  void shuffle(std::vector<unsigned>& order) {
+    for (unsigned i = 0; i < order.size(); i++) {
+      const int r = Digipen::Utils::Random(static_cast<int>(i), static_cast<int>(order.size()) - 1);
+      std::swap(order[i], order[static_cast<unsigned>(r)]);
+    }
+  }
+
+  template<typename Allocate, typename Free>
+  double stress(const std::vector<unsigned>& order, Allocate allocate, Free free) {
+    std::vector<void*> ptrs(TOTAL);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < TOTAL; i++) {
+      ptrs[i] = allocate();
+    }
+
+    for (unsigned i = 0; i < TOTAL; i++) {
+      free(ptrs[order[i]]);
+    }
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  template<typename Round>
+  void report(const char* name, Round round) {
+    double best = 0;
+
+    for (unsigned r = 0; r < ROUNDS; r++) {
+      const double ms = round();
+      best = r == 0 or ms < best ? ms : best;
+    }
+
+    std::printf("%-40s %8.2f ms  %6.1f ns/op\n", name, best, best * 1e6 / (2.0 * TOTAL));
+  }
+
+  void bench_resource(const char* name, std::pmr::memory_resource& resource, const std::vector<unsigned>& order) {
+    report(name, [&] {
+      return stress(
+        order,
+        [&] { return resource.allocate(sizeof(Student), alignof(Student)); },
+        [&](void* p) { resource.deallocate(p, sizeof(Student), alignof(Student)); }
+      );
+    });
+  }
+}
+
+int main() {
+  std::vector<unsigned> order(TOTAL);
+
+  for (unsigned i = 0; i < TOTAL; i++) {
+    order[i] = i;
+  }
+
+  Digipen::Utils::srand(8, 3);
+  shuffle(order);
+
+  std::printf("Stress: %u objects of %zu bytes, best of %u rounds\n", TOTAL, sizeof(Student), ROUNDS);
+
+  report("ObjectAllocator (Stress config)", [&] {
+    ObjectAllocator oa(sizeof(Student), OAConfig(false, OBJECTS, PAGES));
+    return stress(order, [&] { return oa.Allocate(); }, [&](void* p) { oa.Free(p); });
+  });
+
+  {
+    ObjectPoolResource resource;
+    bench_resource("ObjectPoolResource (default, mapped)", resource, order);
+  }
+
+  {
+    ObjectPoolResource resource(OAConfig(false, OBJECTS, 0));
+    bench_resource("ObjectPoolResource (4096 per page, heap)", resource, order);
+  }
+
+  {
+    std::pmr::unsynchronized_pool_resource resource;
+    bench_resource("unsynchronized_pool_resource", resource, order);
+  }
+
+  bench_resource("new_delete_resource", *std::pmr::new_delete_resource(), order);
+
+  return 0;
+}